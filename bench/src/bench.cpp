@@ -0,0 +1,204 @@
+#include "../../search/smp.h"
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+
+using namespace gv;
+
+/**************************************************************************************************************/
+// MAIN
+
+struct BenchRun
+{
+    long long nodes;
+    double time;
+};
+
+// searches every bench position with a cleared table and returns the totals
+static BenchRun runBench(int threads, search::SearchLimits limits, std::size_t hashMB, const search::Evaluator& eval)
+{
+    search::TranspositionTable tt(hashMB);
+    search::ParallelSearch searcher(&tt, threads);
+    searcher.setEvaluator(eval);
+
+    BenchRun run = { 0, 0.0 };
+    for (auto& fen : search::benchPositions)
+    {
+        chessboard::Board board;
+        board.loadFEN(fen);
+        tt.clear();
+
+        search::SearchResult result = searcher.search(board, limits);
+        run.nodes += result.nodes;
+        run.time += result.time;
+    }
+    return run;
+}
+
+// evaluates every position along the same pseudo random lines from each bench position, as a search would at its leaves
+static BenchRun runEvalBench(search::Evaluator& eval, int linesPerPosition)
+{
+    const int LINE_LENGTH = 24;
+    BenchRun run = { 0, 0.0 };
+    volatile int sink = 0;
+    for (auto& fen : search::benchPositions)
+    {
+        chessboard::Board board;
+        board.loadFEN(fen);
+
+        std::uint32_t state = 1;
+        auto start = std::chrono::steady_clock::now();
+        for (int line = 0; line < linesPerPosition; ++line)
+        {
+            int depth = 0;
+            chessboard::MoveList mvs;
+            for (; depth < LINE_LENGTH; ++depth)
+            {
+                board.generateMoves(mvs);
+                if (mvs.size == 0)
+                    break;
+
+                // every move of the node is evaluated, then the line continues down one of them
+                for (auto mv : mvs)
+                {
+                    board.makeMove(mv);
+                    sink = sink + eval.evaluate(board);
+                    board.unmakeMove();
+                    run.nodes++;
+                }
+                state = state*1664525u + 1013904223u;
+                board.makeMove(mvs[(state >> 8) % mvs.size]);
+            }
+            for (; depth > 0; --depth)
+            {
+                board.unmakeMove();
+            }
+        }
+        run.time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return run;
+}
+
+static void printUsage()
+{
+    std::cout << "usage: bench [-threads maxThreads] [-movetime ms] [-depth depth] [-hash mb] [-net file] [-eval] [-savenet file]" << std::endl;
+    std::cout << "searches the bench positions with 1, 2, 4, ... maxThreads threads and reports nodes/sec scaling" << std::endl;
+    std::cout << "with -depth the speedup is time to depth, otherwise each position is searched for movetime (default 1000 ms)" << std::endl;
+    std::cout << "-net searches with a network evaluation, -eval compares evals/sec of the handcrafted evaluation and the network" << std::endl;
+    std::cout << "(the built in test network unless -net is given), -savenet writes the test network to a file" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int maxThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+    int movetime = 1000;
+    int depth = 0;
+    std::size_t hashMB = 64;
+    std::string netFile;
+    bool evalBench = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-threads" && i + 1 < argc)
+        {
+            maxThreads = std::max(std::atoi(argv[++i]), 1);
+        }
+        else if (arg == "-movetime" && i + 1 < argc)
+        {
+            movetime = std::atoi(argv[++i]);
+        }
+        else if (arg == "-depth" && i + 1 < argc)
+        {
+            depth = std::atoi(argv[++i]);
+        }
+        else if (arg == "-hash" && i + 1 < argc)
+        {
+            hashMB = std::atoi(argv[++i]);
+        }
+        else if (arg == "-net" && i + 1 < argc)
+        {
+            netFile = argv[++i];
+        }
+        else if (arg == "-eval")
+        {
+            evalBench = true;
+        }
+        else if (arg == "-savenet" && i + 1 < argc)
+        {
+            std::string path = argv[++i];
+            if (search::Network::makeTestNetwork()->save(path) == false)
+            {
+                std::cout << "could not write " << path << std::endl;
+                return 1;
+            }
+            std::cout << "test network written to " << path << std::endl;
+            return 0;
+        }
+        else
+        {
+            printUsage();
+            return (arg == "-h" || arg == "-help") ? 0 : 1;
+        }
+    }
+
+    std::shared_ptr<search::Network> network;
+    if (netFile.empty() == false)
+    {
+        network.reset(new search::Network());
+        if (network->load(netFile) == false)
+        {
+            std::cout << "could not load network " << netFile << std::endl;
+            return 1;
+        }
+    }
+
+    if (evalBench)
+    {
+        search::Evaluator handcrafted;
+        search::Evaluator nnue;
+        nnue.setNetwork(network ? network : std::shared_ptr<search::Network>(search::Network::makeTestNetwork()));
+
+        BenchRun hcRun = runEvalBench(handcrafted, 200);
+        BenchRun nnRun = runEvalBench(nnue, 200);
+        double hcRate = hcRun.nodes / std::max(hcRun.time, 1e-9);
+        double nnRate = nnRun.nodes / std::max(nnRun.time, 1e-9);
+        std::cout << "handcrafted  evals " << hcRun.nodes << "  time " << hcRun.time << " s  evals/sec " << (long long)hcRate << std::endl;
+        std::cout << "nnue         evals " << nnRun.nodes << "  time " << nnRun.time << " s  evals/sec " << (long long)nnRate
+            << "  relative " << nnRate / hcRate << std::endl;
+        std::cout << "(both include the make/unmake of the move before each evaluation)" << std::endl;
+        return 0;
+    }
+
+    search::Evaluator eval;
+    eval.setNetwork(network);
+
+    search::SearchLimits limits;
+    if (depth > 0)
+        limits.depth = depth;
+    else
+        limits.movetime = movetime;
+
+    std::vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2)
+    {
+        threadCounts.push_back(t);
+    }
+    threadCounts.push_back(maxThreads);
+
+    BenchRun base = { 0, 0.0 };
+    for (int threads : threadCounts)
+    {
+        BenchRun run = runBench(threads, limits, hashMB, eval);
+        if (threads == 1)
+            base = run;
+
+        double nps = run.nodes / std::max(run.time, 1e-9);
+        double baseNps = base.nodes / std::max(base.time, 1e-9);
+        std::cout << "threads " << threads << "  nodes " << run.nodes << "  time " << run.time << " s  nps " << (long long)nps;
+        if (depth > 0)
+            std::cout << "  time to depth speedup " << base.time / std::max(run.time, 1e-9);
+        std::cout << "  nps speedup " << nps / baseNps << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+/* Opening books in the Polyglot .bin format */
+#pragma once
+
+#include "../chessboard/chessboard.h"
+
+namespace gv
+{
+
+namespace book
+{
+
+// Polyglot keys xor together 781 random numbers: 768 for the pieces ([kind][square], kinds ordered black pawn, white
+// pawn, black knight, ... white king), 4 for the castling rights, 8 for the file of an en passant square a pawn of the
+// player to move can take onto, and 1 when white is to move
+// the built in numbers are the standard Random64 table from the Polyglot book format description, so books written
+// by other Polyglot tools match, another table can be loaded for books made with their own numbers
+const int NUM_KEYS = 781;
+
+// the key of the starting position given by the Polyglot book format description, matched only by the standard table
+const std::uint64_t STANDARD_START_KEY = 0x463B96181691FC9CULL;
+
+struct PolyglotKeys
+{
+    std::uint64_t random[NUM_KEYS];
+
+    PolyglotKeys();
+    bool load(const std::string& path); // reads 781 hex numbers from a text file, false unless there are exactly 781
+
+    std::uint64_t key(chessboard::Board& board) const;
+    bool isStandard() const; // true if the starting position has the standard key, so books from other tools match
+};
+
+// a book entry, stored big endian in 16 bytes
+// move: to square in bits 0-5, from square in bits 6-11 (rank*8 + file), promotion piece in bits 12-14
+// (1 knight, 2 bishop, 3 rook, 4 queen), castling is written as the king taking its own rook
+struct BookEntry
+{
+    std::uint64_t key;
+    std::uint16_t move;
+    std::uint16_t weight;
+    std::uint32_t learn;
+};
+
+std::uint16_t toPolyglotMove(chessboard::PackedMove mv);
+
+// the most moves a position's entries are read for
+const int MAX_BOOK_MOVES = 64;
+
+// read only book, the file is memory mapped and binary searched by key so opening it reads nothing up front
+class Book
+{
+
+private:
+    PolyglotKeys keys;
+    const unsigned char* data;
+    std::size_t numEntries;
+
+public:
+    Book() : data(nullptr), numEntries(0) {}
+    Book(const Book&) = delete;
+    Book& operator=(const Book&) = delete;
+    ~Book();
+
+    bool open(const std::string& path); // false if the file can't be mapped or isn't a whole number of entries
+    void close();
+    bool isOpen() const;
+    std::size_t size() const;
+    PolyglotKeys& getKeys();
+
+    // writes the position's entries, heaviest first, whose moves are legal, and returns how many
+    int probe(chessboard::Board& board, BookEntry* entries, chessboard::PackedMove* mvs, int maxEntries = MAX_BOOK_MOVES);
+
+    // picks one of the position's moves with probability proportional to its weight, random is any random number
+    // returns the null move if the position isn't in the book or all its weights are 0
+    chessboard::PackedMove pickMove(chessboard::Board& board, std::uint64_t random);
+
+private:
+    BookEntry entry(std::size_t i) const;
+};
+
+// collects the moves played from the first positions of games and writes them as a book
+// a move's weight is 2 per win and 1 per draw of the player who made it, summed over every game that played it
+class BookBuilder
+{
+
+private:
+    struct Tally
+    {
+        std::uint64_t key;
+        std::uint16_t move;
+        std::uint32_t score;
+        std::uint32_t games;
+    };
+
+    std::vector<Tally> tallies; // one per move played until save gathers them
+
+public:
+    // board holds the game's start position and is left at the last position added
+    // result is "1-0", "0-1" or "1/2-1/2", games with other results are skipped
+    void addGame(chessboard::Board& board, const PolyglotKeys& keys, const std::vector<chessboard::PackedMove>& moves, std::string_view result, int maxPlies);
+    void add(const BookBuilder& other);
+    std::size_t size() const; // moves collected
+
+    // writes the moves played in at least minGames games and not only by losers, weights are scaled down per position to fit 16 bits
+    // returns the number of entries written, -1 if the file can't be written
+    long long save(const std::string& path, int minGames);
+};
+
+} // namespace book
+
+} // namespace gv
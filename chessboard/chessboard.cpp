@@ -1,4 +1,10 @@
 #include "chessboard.h"
+#include <cstdlib>
+#include <cctype>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 namespace gv
 {
@@ -51,6 +57,7 @@ std::ostream& operator<<(std::ostream& os, Piece t)
         case BISHOP:    os << "Bishop"; break;
         case QUEEN:     os << "Queen";  break;
         case KING:      os << "King";   break;
+        case PIECE_NULL: os << "Piece NULL"; break;
     }
     return os;
 }
@@ -117,6 +124,27 @@ bool operator!=(Move lh, Move rh)
     return !(lh == rh);
 }
 
+/**************************************************************************************/
+// PACKED MOVE STRUCT
+
+static const Piece promotionPieces[4] = { KNIGHT, BISHOP, ROOK, QUEEN };
+
+Piece PackedMove::promotion() const
+{
+    return isPromotion() ? promotionPieces[flags() & 3] : PIECE_NULL;
+}
+Move PackedMove::toMove() const
+{
+    return Move(GridVector(start() % 8, start() / 8), GridVector(end() % 8, end() / 8));
+}
+std::ostream& operator<<(std::ostream& os, PackedMove mv)
+{
+    os << mv.toMove();
+    if (mv.isPromotion())
+        os << " = " << mv.promotion();
+    return os;
+}
+
 /**************************************************************************************/
 // MOVE CALLBACK ENUM
 
@@ -132,44 +160,385 @@ std::ostream& operator<<(std::ostream& os, MoveCallback t)
 }
 
 /**************************************************************************************/
-// BOARD
+// ZOBRIST KEYS
 
-// [PUBLIC] ctor for board
-Board::Board()
+// pseudo random keys for hashing positions, generated at compile time so every build hashes positions identically
+struct ZobristKeys
+{
+    std::uint64_t piece[2][6][64];
+    std::uint64_t castling[16]; // indexed by the castle rights bit mask, each entry is the xor of the keys of its rights
+    std::uint64_t enpssnt[8]; // by file of the en passant square
+    std::uint64_t side; // included when black is to move
+
+    constexpr ZobristKeys() : piece(), castling(), enpssnt(), side()
+    {
+        std::uint64_t state = 0x9E3779B97F4A7C15ULL;
+        for (int p = 0; p < 2; ++p)
+            for (int t = 0; t < 6; ++t)
+                for (int i = 0; i < 64; ++i)
+                    piece[p][t][i] = splitMix64(state);
+
+        std::uint64_t rights[4] = { splitMix64(state), splitMix64(state), splitMix64(state), splitMix64(state) };
+        for (int mask = 0; mask < 16; ++mask)
+        {
+            for (int r = 0; r < 4; ++r)
+            {
+                if (mask & (1 << r))
+                    castling[mask] ^= rights[r];
+            }
+        }
+
+        for (int f = 0; f < 8; ++f)
+            enpssnt[f] = splitMix64(state);
+
+        side = splitMix64(state);
+    }
+
+    static constexpr std::uint64_t splitMix64(std::uint64_t& state)
+    {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+};
+
+static constexpr ZobristKeys zobrist;
+
+/**************************************************************************************/
+// PIECE-SQUARE TABLES
+
+// piece values and placement bonuses, [piece] indexed in Piece order
+static constexpr TaperedScore pieceValues[6] = { {100,120}, {500,530}, {320,300}, {330,320}, {900,950}, {0,0} };
+static constexpr int phaseWeights[6] = { 0, 2, 1, 1, 4, 0 };
+
+// placement bonuses as seen by white with rank 8 on the first row, [piece][square]
+// knights, bishops, rooks and queens use the same table in the midgame and endgame
+static constexpr int psqtMg[6][64] = {
+    { // pawn
+      0,  0,  0,  0,  0,  0,  0,  0,
+     50, 50, 50, 50, 50, 50, 50, 50,
+     10, 10, 20, 30, 30, 20, 10, 10,
+      5,  5, 10, 25, 25, 10,  5,  5,
+      0,  0,  0, 20, 20,  0,  0,  0,
+      5, -5,-10,  0,  0,-10, -5,  5,
+      5, 10, 10,-20,-20, 10, 10,  5,
+      0,  0,  0,  0,  0,  0,  0,  0 },
+    { // rook
+      0,  0,  0,  0,  0,  0,  0,  0,
+      5, 10, 10, 10, 10, 10, 10,  5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+      0,  0,  0,  5,  5,  0,  0,  0 },
+    { // knight
+    -50,-40,-30,-30,-30,-30,-40,-50,
+    -40,-20,  0,  0,  0,  0,-20,-40,
+    -30,  0, 10, 15, 15, 10,  0,-30,
+    -30,  5, 15, 20, 20, 15,  5,-30,
+    -30,  0, 15, 20, 20, 15,  0,-30,
+    -30,  5, 10, 15, 15, 10,  5,-30,
+    -40,-20,  0,  5,  5,  0,-20,-40,
+    -50,-40,-30,-30,-30,-30,-40,-50 },
+    { // bishop
+    -20,-10,-10,-10,-10,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5, 10, 10,  5,  0,-10,
+    -10,  5,  5, 10, 10,  5,  5,-10,
+    -10,  0, 10, 10, 10, 10,  0,-10,
+    -10, 10, 10, 10, 10, 10, 10,-10,
+    -10,  5,  0,  0,  0,  0,  5,-10,
+    -20,-10,-10,-10,-10,-10,-10,-20 },
+    { // queen
+    -20,-10,-10, -5, -5,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5,  5,  5,  5,  0,-10,
+     -5,  0,  5,  5,  5,  5,  0, -5,
+      0,  0,  5,  5,  5,  5,  0, -5,
+    -10,  5,  5,  5,  5,  5,  0,-10,
+    -10,  0,  5,  0,  0,  0,  0,-10,
+    -20,-10,-10, -5, -5,-10,-10,-20 },
+    { // king, stays behind its pawns
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -20,-30,-30,-40,-40,-30,-30,-20,
+    -10,-20,-20,-20,-20,-20,-20,-10,
+     20, 20,  0,  0,  0,  0, 20, 20,
+     20, 30, 10,  0,  0, 10, 30, 20 },
+};
+
+static constexpr int pawnEg[64] = { // passed and advanced pawns grow in value as pieces come off
+      0,  0,  0,  0,  0,  0,  0,  0,
+     80, 80, 80, 80, 80, 80, 80, 80,
+     50, 50, 50, 50, 50, 50, 50, 50,
+     30, 30, 30, 30, 30, 30, 30, 30,
+     20, 20, 20, 20, 20, 20, 20, 20,
+     10, 10, 10, 10, 10, 10, 10, 10,
+     10, 10, 10, 10, 10, 10, 10, 10,
+      0,  0,  0,  0,  0,  0,  0,  0 };
+
+static constexpr int kingEg[64] = { // the king heads for the centre
+    -50,-40,-30,-20,-20,-30,-40,-50,
+    -30,-20,-10,  0,  0,-10,-20,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-30,  0,  0,  0,  0,-30,-30,
+    -50,-30,-30,-30,-30,-30,-30,-50 };
+
+// value plus placement bonus of every piece on every square, negated for black, built at compile time
+struct PSQTables
+{
+    TaperedScore score[2][6][64]; // [player][piece][square]
+
+    constexpr PSQTables() : score()
+    {
+        for (int t = 0; t < 6; ++t)
+        {
+            for (int i = 0; i < 64; ++i)
+            {
+                // white reads the table upside down, black's rank 8 is its first row
+                int mg = psqtMg[t][i ^ 56];
+                int eg = (t == PAWN) ? pawnEg[i ^ 56] : (t == KING) ? kingEg[i ^ 56] : mg;
+                score[WHITE][t][i] = { pieceValues[t].mg + mg, pieceValues[t].eg + eg };
+
+                mg = psqtMg[t][i];
+                eg = (t == PAWN) ? pawnEg[i] : (t == KING) ? kingEg[i] : mg;
+                score[BLACK][t][i] = { -(pieceValues[t].mg + mg), -(pieceValues[t].eg + eg) };
+            }
+        }
+    }
+};
+
+static constexpr PSQTables psqt;
+
+/**************************************************************************************/
+// ATTACK TABLES
+
+// ray directions, rook directions come first then bishop directions
+static constexpr int rayDirs[8][2] = { {0,1}, {0,-1}, {1,0}, {-1,0}, {-1,-1}, {1,-1}, {-1,1}, {1,1} };
+static constexpr bool rayPositive[8] = { true, false, true, false, false, false, true, true }; // direction runs towards increasing square index
+
+// attack sets of the leaping pieces and empty board rays from every square, built at compile time
+struct AttackTables
+{
+    Bitboard knight[64];
+    Bitboard king[64];
+    Bitboard pawn[2][64]; // [player][square]
+    Bitboard ray[8][64]; // [direction][square]
+
+    constexpr AttackTables() : knight(), king(), pawn(), ray()
+    {
+        constexpr int knightSteps[8][2] = { {-2,-1}, {-1,-2}, {2,-1}, {-1,2}, {-2,1}, {1,-2}, {2,1}, {1,2} };
+        for (int i = 0; i < 64; ++i)
+        {
+            for (int k = 0; k < 8; ++k)
+            {
+                knight[i] |= stepBB(i, knightSteps[k][0], knightSteps[k][1]);
+                king[i] |= stepBB(i, rayDirs[k][0], rayDirs[k][1]);
+            }
+            pawn[WHITE][i] = stepBB(i, -1, 1) | stepBB(i, 1, 1);
+            pawn[BLACK][i] = stepBB(i, -1, -1) | stepBB(i, 1, -1);
+
+            for (int d = 0; d < 8; ++d)
+            {
+                for (int step = 1; stepBB(i, rayDirs[d][0]*step, rayDirs[d][1]*step) != 0; ++step)
+                    ray[d][i] |= stepBB(i, rayDirs[d][0]*step, rayDirs[d][1]*step);
+            }
+        }
+    }
+
+    // the square a step away from a square, empty if the step leaves the board
+    static constexpr Bitboard stepBB(int ind, int df, int dr)
+    {
+        int file = ind % 8 + df;
+        int rank = ind / 8 + dr;
+        return (file >= 0 && file < 8 && rank >= 0 && rank < 8) ? Bitboard(1) << (rank*8 + file) : 0;
+    }
+};
+
+static constexpr AttackTables attackTables;
+
+// squares covered along one ray direction from a square, up to and including the first occupied square
+static Bitboard rayAttacksBB(int dir, int ind, Bitboard occ)
+{
+    Bitboard attacks = attackTables.ray[dir][ind];
+    Bitboard blockers = attacks & occ;
+    if (blockers)
+    {
+        int blocker = rayPositive[dir] ? lsb(blockers) : msb(blockers);
+        attacks ^= attackTables.ray[dir][blocker]; // remove squares hidden behind the blocker
+    }
+    return attacks;
+}
+
+// multipliers mapping every blocker subset of a square to a table index without destructive collisions
+static constexpr Bitboard rookMagics[64] = {
+    0x008000908064C000ULL, 0x0040200040001000ULL, 0x0180100080A0010AULL, 0x8880041000800800ULL,
+    0x1200100201200804ULL, 0x0200020004011008ULL, 0x2180010000800600ULL, 0x0200005088210204ULL,
+    0x0400800040008021ULL, 0x0400400020005000ULL, 0x8240801000200080ULL, 0x8611001004200900ULL,
+    0x008180800C001800ULL, 0x0100800200800400ULL, 0x0A02000102000408ULL, 0x8020802300104280ULL,
+    0x0080004000402000ULL, 0xE010104000402000ULL, 0x0800808010002000ULL, 0xA280210008100100ULL,
+    0x0001818014000800ULL, 0xA002010100080400ULL, 0x0080240001020870ULL, 0x0001020004048845ULL,
+    0x0081826280004004ULL, 0x2020810900284000ULL, 0x0200100080802000ULL, 0x0200080080100080ULL,
+    0x8083080100100500ULL, 0x4406000901000400ULL, 0x0005020080800100ULL, 0x0090204200008114ULL,
+    0x0010400094800420ULL, 0x0900804000802002ULL, 0x0201001841002000ULL, 0x4100080080801000ULL,
+    0x4540040080800800ULL, 0x0002001004040020ULL, 0x0281195814001002ULL, 0x1240800040800100ULL,
+    0x0880042000524004ULL, 0x02C080410206002CULL, 0x0801200241050010ULL, 0x8400080010008080ULL,
+    0x0008000500090010ULL, 0x0082009084020008ULL, 0x4012000108020004ULL, 0x9000104D08860004ULL,
+    0x2004204114800100ULL, 0x0148802112400300ULL, 0x0202842000100880ULL, 0x001B080080900080ULL,
+    0x001A002008100600ULL, 0x0004008004020080ULL, 0x5181000600040300ULL, 0x0000044401128A00ULL,
+    0x8044110480002441ULL, 0x2008110084402202ULL, 0x90806005090010C1ULL, 0x000420310A004A42ULL,
+    0x0023001004020801ULL, 0x0882001008040102ULL, 0x000230088118020CULL, 0x0000019025040042ULL
+};
+
+static constexpr Bitboard bishopMagics[64] = {
+    0x0045010808008680ULL, 0x2002080204004898ULL, 0x0210009A10400006ULL, 0x0824050200810200ULL,
+    0x0006061105004090ULL, 0x00010108C0000000ULL, 0x0814040282104004ULL, 0x0012012201106800ULL,
+    0x10823014100C1040ULL, 0x0080C2088802808CULL, 0x0281108410404000ULL, 0x0101212041826200ULL,
+    0x0020141028221058ULL, 0x2201020202200202ULL, 0x000082A801482000ULL, 0x0000008401411044ULL,
+    0x0007103014300404ULL, 0x0002091110010100ULL, 0x42140012040C0808ULL, 0x0800808802004020ULL,
+    0x90C4004210140000ULL, 0x0800200900A01000ULL, 0x00D0400201108810ULL, 0x80820183814412A0ULL,
+    0x00A01008202202B4ULL, 0x01C2021A09500402ULL, 0x0084440208042400ULL, 0x800400400C090100ULL,
+    0xBA10040010802100ULL, 0xD182009006005000ULL, 0x5011021001009004ULL, 0x0020420200510400ULL,
+    0x0292104000468800ULL, 0x00043009091C0500ULL, 0x0280441000020025ULL, 0x0042820080080080ULL,
+    0x0440101010010040ULL, 0x1000900100808080ULL, 0x0108108120089800ULL, 0x0044010200012682ULL,
+    0xC002500420900400ULL, 0x0040482210710800ULL, 0x0002060024000200ULL, 0x0281020A44000800ULL,
+    0xA0021200A4000200ULL, 0x0001301000840840ULL, 0x2868500108444220ULL, 0x0004111041000200ULL,
+    0x8044020842080200ULL, 0x0000220104210200ULL, 0x0000021201044000ULL, 0x0000280884040028ULL,
+    0x4012114010858003ULL, 0x0000081004082B88ULL, 0x3892700508208002ULL, 0x00220A041B060400ULL,
+    0x0812020284014881ULL, 0x010434A282103100ULL, 0x0490400824020800ULL, 0x4A20002C00208800ULL,
+    0x000000A011020200ULL, 0x4002940A02482202ULL, 0x5100100202140406ULL, 0x02102000840540C1ULL
+};
+
+// slider attacks looked up by the occupancy of the squares that can block the slider
+// with BMI2 the table index is the pext of the occupancy, otherwise it comes from a magic multiply
+struct SliderTables
 {
+    struct Entry
+    {
+        Bitboard mask; // squares that can block the slider, the last square of each ray is left out
+        Bitboard magic;
+        int shift;
+        Bitboard* attacks; // this square's part of the table
+
+        unsigned int index(Bitboard occ) const
+        {
+#if defined(__BMI2__)
+            return (unsigned int)_pext_u64(occ, mask);
+#else
+            return (unsigned int)(((occ & mask)*magic) >> shift);
+#endif
+        }
+    };
+
+    Entry rook[64];
+    Entry bishop[64];
+    Bitboard rookTable[102400];
+    Bitboard bishopTable[5248];
+
+    SliderTables()
+    {
+        init(rook, rookTable, rookMagics, 0);
+        init(bishop, bishopTable, bishopMagics, 4);
+    }
+
+    // fills each square's part of the table by walking every subset of its blocker mask
+    static void init(Entry* entries, Bitboard* table, const Bitboard* magics, int firstDir)
+    {
+        for (int i = 0; i < 64; ++i)
+        {
+            Entry& e = entries[i];
+            e.mask = 0;
+            for (int d = firstDir; d < firstDir + 4; ++d)
+            {
+                Bitboard ray = attackTables.ray[d][i];
+                if (ray)
+                    ray &= ~sqrBB(rayPositive[d] ? msb(ray) : lsb(ray));
+                e.mask |= ray;
+            }
+            e.magic = magics[i];
+            e.shift = 64 - popCount(e.mask);
+            e.attacks = table;
+            table += Bitboard(1) << popCount(e.mask);
+
+            Bitboard occ = 0;
+            do
+            {
+                Bitboard attacks = 0;
+                for (int d = firstDir; d < firstDir + 4; ++d)
+                    attacks |= rayAttacksBB(d, i, occ);
+                e.attacks[e.index(occ)] = attacks;
+                occ = (occ - e.mask) & e.mask;
+            } while (occ);
+        }
+    }
+};
 
-    // INTIALISE PIECE SETTINGS
-    // Pawn
-    moveVectors[PAWN] = {}; // pawn move options are defined in function
-    moveConstraint[PAWN] = true;
+static const SliderTables sliderTables;
+
+Bitboard knightAttacks(int ind)
+{
+    return attackTables.knight[ind];
+}
 
-    // Rook
-    moveVectors[ROOK] = { {0,1}, {0,-1}, {1,0}, {-1,0} };
-    moveConstraint[ROOK] = false;
+Bitboard kingAttacks(int ind)
+{
+    return attackTables.king[ind];
+}
 
-    // Knight
-    moveVectors[KNIGHT] = { {-2,-1}, {-1,-2}, {2,-1}, {-1,2}, {-2,1}, {1,-2}, {2,1}, {1,2} };
-    moveConstraint[KNIGHT] = true;
+Bitboard pawnAttacks(Player plr, int ind)
+{
+    return attackTables.pawn[plr][ind];
+}
 
-    // Bishop
-    moveVectors[BISHOP] = { {-1,-1}, {1,-1}, {-1,1}, {1,1} };
-    moveConstraint[BISHOP] = false;
+Bitboard rookAttacks(int ind, Bitboard occ)
+{
+    const SliderTables::Entry& e = sliderTables.rook[ind];
+    return e.attacks[e.index(occ)];
+}
 
-    // Queen
-    moveVectors[QUEEN] = { {0,1}, {0,-1}, {1,0}, {-1,0}, {-1,-1}, {1,-1}, {-1,1}, {1,1} };
-    moveConstraint[QUEEN] = false;
+Bitboard bishopAttacks(int ind, Bitboard occ)
+{
+    const SliderTables::Entry& e = sliderTables.bishop[ind];
+    return e.attacks[e.index(occ)];
+}
 
-    // King
-    moveVectors[KING] = { {0,1}, {0,-1}, {1,0}, {-1,0}, {-1,-1}, {1,-1}, {-1,1}, {1,1} };
-    moveConstraint[KING] = true;
+/**************************************************************************************/
+// BOARD
 
+// [PUBLIC] ctor for board
+Board::Board()
+{
     // Initialise empty board
-    sqrPieces = std::vector<Piece>(64, PIECE_NULL);
-    sqrOwners = std::vector<Player>(64, PLAYER_NULL);
+    std::fill(sqrPieces, sqrPieces + 64, PIECE_NULL);
+    std::fill(sqrOwners, sqrOwners + 64, PLAYER_NULL);
+    std::memset(pieceBB, 0, sizeof(pieceBB));
+    std::memset(occupancyBB, 0, sizeof(occupancyBB));
+    allBB = 0;
+    hashKey = 0;
+    pawnKey = 0;
+    psqtScore = { 0, 0 };
+    phase = 0;
+    dirtyBB = ~Bitboard(0); // coverage of every square is computed on first evaluation
 
     // functionality assets
-    sqrCoverage = std::vector<std::vector<SqrCover>>(64, std::vector<SqrCover>());
-    validMoves = std::vector<std::vector<Move>>(64, std::vector<Move>());
+    undoStack.reserve(512);
+    hashHistory.reserve(512);
+    raysEvaluated = false;
+    attacksEvaluated = false;
+    evaluated = false;
+}
+
+// [PUBLIC] ctor from a position snapshot, an invalid snapshot leaves the board empty
+Board::Board(const Position& pos) : Board()
+{
+    loadPosition(pos);
 }
 
 // [PUBLIC]
@@ -210,32 +579,363 @@ void Board::setup()
     rookQSMoved[WHITE] = false;
     rookQSMoved[BLACK] = false;
 
+    enpssntSqr = GridVector();
+    halfmoveClock = 0;
+    fullmoveNumber = 1;
+    undoStack.clear();
+    hashHistory.clear();
+
     plrToMove = WHITE;
     status = IN_PROGRESS;
     check = PLAYER_NULL;
     winner = PLAYER_NULL;
+    hashKey = computeHash();
 
     evaluateBoard(); // initially step system
 }
 
+// returns false if the character is not a FEN piece letter
+static bool fenCharToPiece(char c, Piece& piece, Player& owner)
+{
+    owner = (c >= 'a' && c <= 'z') ? BLACK : WHITE;
+    switch (c)
+    {
+        case 'p': case 'P': piece = PAWN;   break;
+        case 'r': case 'R': piece = ROOK;   break;
+        case 'n': case 'N': piece = KNIGHT; break;
+        case 'b': case 'B': piece = BISHOP; break;
+        case 'q': case 'Q': piece = QUEEN;  break;
+        case 'k': case 'K': piece = KING;   break;
+        default: return false;
+    }
+    return true;
+}
+
+static char pieceToFENChar(Piece piece, Player owner)
+{
+    static const char letters[] = "prnbqk";
+    char c = letters[piece];
+    return (owner == WHITE) ? char(c - 'a' + 'A') : c;
+}
+
+// removes and returns the next space separated field of a string
+static std::string_view nextFENField(std::string_view& str)
+{
+    size_t start = str.find_first_not_of(' ');
+    if (start == std::string_view::npos)
+    {
+        str = std::string_view();
+        return str;
+    }
+    str.remove_prefix(start);
+    std::string_view field = str.substr(0, str.find(' '));
+    str.remove_prefix(field.size());
+    return field;
+}
+
+// returns false if the field is empty or not a non-negative integer
+static bool parseFENInt(std::string_view field, int& val)
+{
+    if (field.empty())
+        return false;
+
+    val = 0;
+    for (char c : field)
+    {
+        if (c < '0' || c > '9')
+            return false;
+        val = val*10 + (c - '0');
+    }
+    return true;
+}
+
+// [PUBLIC] sets up the board from a FEN string, the board is left unchanged and false returned if the string is malformed
+// clocks may be omitted, in which case they default to 0 and 1
+bool Board::loadFEN(std::string_view fen)
+{
+    Piece pieces[64];
+    Player owners[64];
+    std::fill(pieces, pieces + 64, PIECE_NULL);
+    std::fill(owners, owners + 64, PLAYER_NULL);
+
+    // piece placement, from rank 8 down to rank 1
+    std::string_view placement = nextFENField(fen);
+    int file = 0;
+    int rank = 7;
+    int numKings[2] = {0, 0};
+    for (char c : placement)
+    {
+        if (c == '/')
+        {
+            if (file != 8 || rank == 0)
+                return false;
+            file = 0;
+            rank--;
+        }
+        else if (c >= '1' && c <= '8')
+        {
+            file += c - '0';
+            if (file > 8)
+                return false;
+        }
+        else
+        {
+            Piece piece;
+            Player owner;
+            if (file > 7 || fenCharToPiece(c, piece, owner) == false)
+                return false;
+            if (piece == KING)
+                numKings[owner]++;
+            pieces[rank*8 + file] = piece;
+            owners[rank*8 + file] = owner;
+            file++;
+        }
+    }
+    if (file != 8 || rank != 0 || numKings[WHITE] != 1 || numKings[BLACK] != 1)
+        return false;
+
+    // player to move
+    std::string_view side = nextFENField(fen);
+    if (side != "w" && side != "b")
+        return false;
+    Player toMove = (side == "w") ? WHITE : BLACK;
+
+    // castling rights
+    std::string_view castling = nextFENField(fen);
+    int rights = 0;
+    if (castling != "-")
+    {
+        if (castling.empty())
+            return false;
+        for (char c : castling)
+        {
+            switch (c)
+            {
+                case 'K': rights |= 1; break;
+                case 'Q': rights |= 2; break;
+                case 'k': rights |= 4; break;
+                case 'q': rights |= 8; break;
+                default: return false;
+            }
+        }
+    }
+
+    // en passant target square
+    std::string_view enpssntField = nextFENField(fen);
+    GridVector epSqr = GridVector();
+    if (enpssntField != "-")
+    {
+        if (enpssntField.size() != 2)
+            return false;
+        epSqr = GridVector(enpssntField[0] - 'a', enpssntField[1] - '1');
+        if (validSqr(epSqr) == false || epSqr.rank != ((toMove == WHITE) ? 5 : 2))
+            return false;
+    }
+
+    // clocks are optional
+    int halfmove = 0;
+    int fullmove = 1;
+    std::string_view halfmoveField = nextFENField(fen);
+    std::string_view fullmoveField = nextFENField(fen);
+    if ((halfmoveField.empty() == false && parseFENInt(halfmoveField, halfmove) == false) || (fullmoveField.empty() == false && parseFENInt(fullmoveField, fullmove) == false))
+        return false;
+
+    fillBoard(pieces, owners, toMove, rights, epSqr, halfmove, fullmove);
+    return true;
+}
+
+// [PRIVATE] sets up the board from validated pieces and flags, castling rights are given as a castleRights() mask
+void Board::fillBoard(const Piece* pieces, const Player* owners, Player toMove, int castling, GridVector epSqr, int halfmove, int fullmove)
+{
+    std::fill(sqrPieces, sqrPieces + 64, PIECE_NULL);
+    std::fill(sqrOwners, sqrOwners + 64, PLAYER_NULL);
+    std::memset(pieceBB, 0, sizeof(pieceBB));
+    std::memset(occupancyBB, 0, sizeof(occupancyBB));
+    allBB = 0;
+    pawnKey = 0;
+    psqtScore = { 0, 0 };
+    phase = 0;
+    dirtyBB = ~Bitboard(0);
+    for (int i = 0; i < 64; ++i)
+    {
+        if (pieces[i] != PIECE_NULL)
+            setSqr(indSqr(i), pieces[i], owners[i]);
+    }
+
+    // castling rights are only kept if the king and rook are still on their starting squares
+    for (int p = WHITE; p <= BLACK; ++p)
+    {
+        Player plr = (Player)p;
+        int homeRank = (plr == WHITE) ? 0 : 7;
+        kingSqr[plr] = indSqr(lsb(pieceBB[plr][KING]));
+        kingMoved[plr] = (kingSqr[plr] != GridVector(4,homeRank));
+        rookKSMoved[plr] = !((castling & (1 << (2*p))) && getSqrPiece({7,homeRank}) == ROOK && getSqrOwner({7,homeRank}) == plr);
+        rookQSMoved[plr] = !((castling & (1 << (2*p + 1))) && getSqrPiece({0,homeRank}) == ROOK && getSqrOwner({0,homeRank}) == plr);
+    }
+
+    // only keep the en passant square if a pawn of the player to move can take onto it
+    enpssntSqr = GridVector();
+    if (validSqr(epSqr) && (pawnAttacks(opponent(toMove), ind(epSqr)) & pieceBB[toMove][PAWN]))
+    {
+        enpssntSqr = epSqr;
+    }
+
+    halfmoveClock = halfmove;
+    fullmoveNumber = fullmove;
+    undoStack.clear();
+    hashHistory.clear();
+
+    plrToMove = toMove;
+    status = IN_PROGRESS;
+    check = PLAYER_NULL;
+    winner = PLAYER_NULL;
+    hashKey = computeHash();
+    raysEvaluated = false;
+    attacksEvaluated = false;
+    evaluated = false;
+}
+
+// [PUBLIC] sets up the board from a position snapshot, the board is left unchanged and false returned if the snapshot
+// doesn't hold one king per side or has a bad square code, the snapshot's hash is not trusted and is recomputed
+bool Board::loadPosition(const Position& pos)
+{
+    Piece pieces[64];
+    Player owners[64];
+    int numKings[2] = {0, 0};
+    for (int i = 0; i < 64; ++i)
+    {
+        if (pos.code(i) > 12)
+            return false;
+        pieces[i] = pos.piece(i);
+        owners[i] = pos.owner(i);
+        if (pieces[i] == KING)
+            numKings[owners[i]]++;
+    }
+    if (numKings[WHITE] != 1 || numKings[BLACK] != 1 || pos.plrToMove > BLACK)
+        return false;
+
+    Player toMove = (Player)pos.plrToMove;
+    GridVector epSqr = GridVector();
+    if (pos.enpssntSqr < 64 && pos.enpssntSqr / 8 == ((toMove == WHITE) ? 5 : 2))
+        epSqr = indSqr(pos.enpssntSqr);
+
+    fillBoard(pieces, owners, toMove, pos.castling & 15, epSqr, pos.halfmoveClock, pos.fullmoveNumber);
+    return true;
+}
+
+// [PUBLIC] returns a snapshot of the position, the move history is not included
+Position Board::toPosition()
+{
+    Position pos;
+    std::memset(&pos, 0, sizeof(pos)); // padding too, so equal positions compare equal with memcmp
+    for (int i = 0; i < 64; ++i)
+    {
+        if (sqrPieces[i] != PIECE_NULL)
+            pos.set(i, sqrPieces[i], sqrOwners[i]);
+    }
+    pos.hash = hashKey;
+    pos.halfmoveClock = std::uint16_t(halfmoveClock);
+    pos.fullmoveNumber = std::uint16_t(fullmoveNumber);
+    pos.plrToMove = std::uint8_t(plrToMove);
+    pos.castling = std::uint8_t(castleRights());
+    pos.enpssntSqr = std::uint8_t(validSqr(enpssntSqr) ? ind(enpssntSqr) : 64);
+    return pos;
+}
+
+// [PUBLIC] returns the position as a FEN string
+std::string Board::toFEN()
+{
+    std::string fen;
+    fen.reserve(96);
+
+    for (int rank = 7; rank >= 0; --rank)
+    {
+        int empty = 0;
+        for (int file = 0; file < 8; ++file)
+        {
+            int i = rank*8 + file;
+            if (sqrPieces[i] == PIECE_NULL)
+            {
+                empty++;
+                continue;
+            }
+            if (empty > 0)
+            {
+                fen += char('0' + empty);
+                empty = 0;
+            }
+            fen += pieceToFENChar(sqrPieces[i], sqrOwners[i]);
+        }
+        if (empty > 0)
+            fen += char('0' + empty);
+        if (rank > 0)
+            fen += '/';
+    }
+
+    fen += (plrToMove == WHITE) ? " w " : " b ";
+
+    size_t castlingStart = fen.size();
+    if (kingMoved[WHITE] == false && rookKSMoved[WHITE] == false) fen += 'K';
+    if (kingMoved[WHITE] == false && rookQSMoved[WHITE] == false) fen += 'Q';
+    if (kingMoved[BLACK] == false && rookKSMoved[BLACK] == false) fen += 'k';
+    if (kingMoved[BLACK] == false && rookQSMoved[BLACK] == false) fen += 'q';
+    if (fen.size() == castlingStart)
+        fen += '-';
+
+    fen += ' ';
+    if (validSqr(enpssntSqr))
+    {
+        fen += char('a' + enpssntSqr.file);
+        fen += char('1' + enpssntSqr.rank);
+    }
+    else
+    {
+        fen += '-';
+    }
+
+    fen += ' ';
+    fen += std::to_string(halfmoveClock);
+    fen += ' ';
+    fen += std::to_string(fullmoveNumber);
+    return fen;
+}
+
 // [PRIVATE]
 int Board::ind(GridVector sqr)
 {
     return sqr.rank*8 + sqr.file;
 }
 
+// [PRIVATE]
+GridVector Board::indSqr(int ind)
+{
+    return GridVector(ind % 8, ind / 8);
+}
+
 // [PUBLIC]
 Piece Board::getSqrPiece(GridVector sqr)
 {
     return sqrPieces[ind(sqr)];
 }
 
+// [PUBLIC] as above for a square index (rank*8 + file)
+Piece Board::getSqrPiece(int ind)
+{
+    return sqrPieces[ind];
+}
+
 // [PUBLIC]
 Player Board::getSqrOwner(GridVector sqr)
 {
     return sqrOwners[ind(sqr)];
 }
 
+// [PUBLIC] as above for a square index (rank*8 + file)
+Player Board::getSqrOwner(int ind)
+{
+    return sqrOwners[ind];
+}
+
 // [PUBLIC]
 bool Board::emptySqr(GridVector sqr)
 {
@@ -248,18 +948,110 @@ bool Board::validSqr(GridVector sqr)
     return ((sqr.file >= 0) && (sqr.file < 8) && (sqr.rank >= 0) && (sqr.rank < 8));
 }
 
+// [PUBLIC] returns the squares holding a player's pieces of a given type
+Bitboard Board::getPieceBB(Player plr, Piece piece)
+{
+    return pieceBB[plr][piece];
+}
+
+// [PUBLIC] returns the squares holding any of a player's pieces
+Bitboard Board::getOccupancyBB(Player plr)
+{
+    return occupancyBB[plr];
+}
+
 // [PRIVATE]
 void Board::setSqr(GridVector sqr, Piece type, Player owner)
 {
-    sqrPieces[ind(sqr)] = type;
-    sqrOwners[ind(sqr)] = owner;
+    if (!emptySqr(sqr))
+        clearSqr(sqr); // remove captured piece from bitboards
+
+    int i = ind(sqr);
+    sqrPieces[i] = type;
+    sqrOwners[i] = owner;
+    hashKey ^= zobrist.piece[owner][type][i];
+    if (type == PAWN)
+        pawnKey ^= zobrist.piece[owner][PAWN][i];
+    psqtScore += psqt.score[owner][type][i];
+    phase += phaseWeights[type];
+    pieceBB[owner][type] |= sqrBB(i);
+    occupancyBB[owner] |= sqrBB(i);
+    allBB |= sqrBB(i);
+    dirtyBB |= sqrBB(i);
 }
 
 // [PRIVATE]
 void Board::clearSqr(GridVector sqr)
 {
-    sqrPieces[ind(sqr)] = PIECE_NULL;
-    sqrOwners[ind(sqr)] = PLAYER_NULL;
+    int i = ind(sqr);
+    if (sqrPieces[i] != PIECE_NULL)
+    {
+        hashKey ^= zobrist.piece[sqrOwners[i]][sqrPieces[i]][i];
+        if (sqrPieces[i] == PAWN)
+            pawnKey ^= zobrist.piece[sqrOwners[i]][PAWN][i];
+        psqtScore -= psqt.score[sqrOwners[i]][sqrPieces[i]][i];
+        phase -= phaseWeights[sqrPieces[i]];
+        pieceBB[sqrOwners[i]][sqrPieces[i]] &= ~sqrBB(i);
+        occupancyBB[sqrOwners[i]] &= ~sqrBB(i);
+        allBB &= ~sqrBB(i);
+        dirtyBB |= sqrBB(i);
+    }
+    sqrPieces[i] = PIECE_NULL;
+    sqrOwners[i] = PLAYER_NULL;
+}
+
+// [PRIVATE] returns castling rights as a bit mask, white king side, white queen side, black king side, black queen side
+int Board::castleRights()
+{
+    int rights = 0;
+    for (int p = WHITE; p <= BLACK; ++p)
+    {
+        if (kingMoved[p] == false && rookKSMoved[p] == false)
+            rights |= 1 << (2*p);
+        if (kingMoved[p] == false && rookQSMoved[p] == false)
+            rights |= 1 << (2*p + 1);
+    }
+    return rights;
+}
+
+// [PRIVATE] hashes the position from scratch, only needed when a position is set up
+std::uint64_t Board::computeHash()
+{
+    std::uint64_t key = 0;
+    for (int i = 0; i < 64; ++i)
+    {
+        if (sqrPieces[i] != PIECE_NULL)
+            key ^= zobrist.piece[sqrOwners[i]][sqrPieces[i]][i];
+    }
+    key ^= zobrist.castling[castleRights()];
+    if (validSqr(enpssntSqr))
+        key ^= zobrist.enpssnt[enpssntSqr.file];
+    if (plrToMove == BLACK)
+        key ^= zobrist.side;
+    return key;
+}
+
+// [PRIVATE] debug check that the incrementally updated piece-square score, phase and pawn key match a recount, aborts if not
+void Board::checkEvalState()
+{
+    TaperedScore score = { 0, 0 };
+    int ph = 0;
+    std::uint64_t key = 0;
+    for (int i = 0; i < 64; ++i)
+    {
+        if (sqrPieces[i] != PIECE_NULL)
+        {
+            score += psqt.score[sqrOwners[i]][sqrPieces[i]][i];
+            ph += phaseWeights[sqrPieces[i]];
+            if (sqrPieces[i] == PAWN)
+                key ^= zobrist.piece[sqrOwners[i]][PAWN][i];
+        }
+    }
+    if (score.mg != psqtScore.mg || score.eg != psqtScore.eg || ph != phase || key != pawnKey)
+    {
+        std::cerr << "Evaluation state mismatch in " << toFEN() << std::endl;
+        std::abort();
+    }
 }
 
 // [PRIVATE]
@@ -280,11 +1072,8 @@ void Board::executeMove(Move mv)
 // [PRIVATE] executes en passant move
 void Board::executeEnPssnt(Move mv)
 {
-    if ((mv.end - mv.start).rank == 1) // white taking black pawn
-    {
-        clearSqr(mv.end - GridVector(0, 1));
-        executeMove(mv);
-    }
+    clearSqr(GridVector(mv.end.file, mv.start.rank)); // captured pawn is beside the start square for either player
+    executeMove(mv);
 }
 
 // [PRIVATE]
@@ -312,6 +1101,8 @@ void Board::executeCastleQS()
 // [PUBLIC] returns which player in check, if any
 Player Board::getCheck() 
 {
+    if (!raysEvaluated)
+        evaluateRays();
     return check;
 }
 
@@ -324,243 +1115,896 @@ Player Board::getPlayerToMove()
 // [PUBLIC] returns game status
 Status Board::getStatus()
 {
+    if (!evaluated)
+        evaluateBoard();
     return status;
 }
 
 // [PUBLIC] returns game winner
 Player Board::getWinner()
 {
+    if (!evaluated)
+        evaluateBoard();
     return winner;
 }
 
-// [PUBLIC]m
-std::vector<Move> Board::getValidMoves(GridVector sqr)
+// [PUBLIC] returns number of plies since the last pawn move or capture
+int Board::getHalfmoveClock()
 {
-    return validMoves[ind(sqr)];
+    return halfmoveClock;
 }
 
-// [PUBLIC] primary function for moving pieces from an outside program
-MoveCallback Board::requestMove(Move mv, Piece pieceFlag)
+// [PUBLIC] returns the current move number
+int Board::getFullmoveNumber()
 {
-    MoveCallback cb = FAILURE;
-
-    if (status == IN_PROGRESS)
-    {
-        bool skip = false;
+    return fullmoveNumber;
+}
 
-        // check if en passant move
-        if (skip == false)
-        {
-            for (auto& epMv : enpssntMoves)
-            {
-                if (mv == epMv && getSqrOwner(epMv.start) == plrToMove) // check that this move can be made by player to move
-                {
-                    executeEnPssnt(mv);
-                    skip = true;
-                    cb = SUCCESS;
-                }
-            }
-        }
+// [PUBLIC] returns the zobrist key of the position
+std::uint64_t Board::hash()
+{
+    return hashKey;
+}
 
-        // check if castling move
-        if (skip == false)
-        {
-            if (kingSqr[plrToMove] == mv.start && castleKSValid == true && (mv.end - mv.start).file == 2)
-            {
-                executeCastleKS();
-                skip = true;
-                cb = SUCCESS;
-            }
-            else if (kingSqr[plrToMove] == mv.start && castleQSValid == true && (mv.end - mv.start).file == -2)
-            {
-                executeCastleQS();
-                skip = true;
-                cb = SUCCESS;
-            }
-        }
+// [PUBLIC] returns the zobrist key of the pawns alone, for caching evaluation terms that only depend on the pawns
+std::uint64_t Board::pawnHash()
+{
+#ifdef CHESSBOARD_DEBUG
+    checkEvalState();
+#endif
+    return pawnKey;
+}
 
-        // if not a special move (en passant/castle) then treat as a normal move and search through valid moves
-        if (skip == false)
-        {
-            for (auto& validMv : validMoves[ind(mv.start)])
-            {
-                if (mv == validMv)
-                {
-                    cb = SUCCESS;
-                }
-            }
+// [PUBLIC] only positions with the same player to move since the last irreversible move can repeat, so the scan runs
+// back over every second key and at most halfmoveClock plies, a position needs 4 plies to come round again
+int Board::getRepetitions()
+{
+    int n = hashHistory.size();
+    int limit = std::min(halfmoveClock, n);
+    int count = 0;
+    for (int k = 4; k <= limit; k += 2)
+    {
+        if (hashHistory[n - k] == hashKey)
+            count++;
+    }
+    return count;
+}
+
+// [PUBLIC]
+bool Board::isRepetition()
+{
+    int n = hashHistory.size();
+    int limit = std::min(halfmoveClock, n);
+    for (int k = 4; k <= limit; k += 2)
+    {
+        if (hashHistory[n - k] == hashKey)
+            return true;
+    }
+    return false;
+}
+
+// [PUBLIC] true once 50 moves by each player have passed without a pawn move or capture
+bool Board::isFiftyMoveDraw()
+{
+    return halfmoveClock >= 100;
+}
+
+// [PUBLIC]
+bool Board::isInsufficientMaterial()
+{
+    if (pieceBB[WHITE][PAWN] | pieceBB[BLACK][PAWN] | pieceBB[WHITE][ROOK] | pieceBB[BLACK][ROOK] | pieceBB[WHITE][QUEEN] | pieceBB[BLACK][QUEEN])
+        return false;
+
+    Bitboard knights = pieceBB[WHITE][KNIGHT] | pieceBB[BLACK][KNIGHT];
+    Bitboard bishops = pieceBB[WHITE][BISHOP] | pieceBB[BLACK][BISHOP];
+    if (popCount(knights | bishops) <= 1)
+        return true;
+    if (knights)
+        return false;
+
+    const Bitboard darkSqrs = 0xAA55AA55AA55AA55ULL;
+    return (bishops & darkSqrs) == 0 || (bishops & ~darkSqrs) == 0;
+}
+
+// [PUBLIC] returns the material plus piece-square score from white's point of view, kept up to date as pieces move
+TaperedScore Board::getPSQTScore()
+{
+#ifdef CHESSBOARD_DEBUG
+    checkEvalState();
+#endif
+    return psqtScore;
+}
+
+// [PUBLIC] returns the game phase, MAX_PHASE with all the starting pieces on the board down to 0 with only kings and pawns
+// promotions can take it above MAX_PHASE
+int Board::getPhase()
+{
+    return phase;
+}
+
+// [PUBLIC] returns the squares covered by a player's pieces, building the coverage if it is out of date
+Bitboard Board::getSqrCoverage(Player plr)
+{
+    if (!attacksEvaluated)
+        evaluateAttacks();
+    return sqrCoverage[plr];
+}
+
+// [PUBLIC] returns the valid moves of the piece on a square, a promotion is listed once whatever the piece
+std::vector<Move> Board::getValidMoves(GridVector sqr)
+{
+    if (!attacksEvaluated)
+        evaluateAttacks();
+
+    std::vector<Move> mvs;
+    if (sqrOwners[ind(sqr)] != plrToMove)
+        return mvs;
+
+    MoveList sqrMvs;
+    updateValidMoves(sqrMvs, GEN_ALL, sqrBB(ind(sqr)));
+    for (auto mv : sqrMvs)
+    {
+        if (!mv.isPromotion() || mv.promotion() == QUEEN)
+            mvs.push_back(mv.toMove());
+    }
+    return mvs;
+}
+
+// [PUBLIC] primary function for moving pieces from an outside program
+MoveCallback Board::requestMove(Move mv, Piece pieceFlag)
+{
+    MoveCallback cb = FAILURE;
+
+    if (getStatus() == IN_PROGRESS && validSqr(mv.start) && validSqr(mv.end))
+    {
+        // en passant and castling moves are included in the valid moves so a single search validates all moves
+        PackedMove packed = packMove(mv, pieceFlag);
+        if (isValidMove(packed))
+        {
+            cb = SUCCESS;
         }
 
         if (cb == SUCCESS) // move has been validated
         {
-            updateEnPssnt(mv); // update en passant before executing move
-            
-            // keep track of king being moved for first time for castling
-            if (mv.start == kingSqr[plrToMove]) // if plr moves king then keep track of this
-            {
-                kingMoved[plrToMove] = true;
-            }
-
-            // keep track of rook being moved for first time for castling
-            int rank = (plrToMove == WHITE) ? 0 : 7;
-            if (mv.start == GridVector(7,rank) && rookKSMoved[plrToMove] == false)
-            {
-                rookKSMoved[plrToMove] = true;
-            }
-            else if (mv.start == GridVector(0,rank) && rookQSMoved[plrToMove] == false)
-            {
-                rookQSMoved[plrToMove] = true;
-            }
+            makeMove(packed);
+            evaluateBoard(); // evaluates board (en passant square already calculated)
+        }
+    }
+    return cb;
+}
 
-            // execute move
-            if (skip == false) // if move already executed in a special way then skip = true
-            {
-                executeMove(mv);
-            }
+// [PUBLIC] encodes a move for the player to move, the move itself is not validated
+PackedMove Board::packMove(Move mv, Piece pieceFlag)
+{
+    int start = ind(mv.start);
+    int end = ind(mv.end);
+    int flags = (sqrPieces[end] != PIECE_NULL) ? CAPTURE : QUIET;
+    GridVector diff = mv.end - mv.start;
 
-            // check if this move is a pawn promotion and thus requires pieceFlag
-            if (getSqrPiece(mv.end) == PAWN && mv.end.rank == (7 - rank))
+    if (sqrPieces[start] == PAWN)
+    {
+        if (mv.end == enpssntSqr && diff.file != 0)
+        {
+            flags = ENPSSNT;
+        }
+        else if (diff.rank == 2 || diff.rank == -2)
+        {
+            flags = DOUBLE_PUSH;
+        }
+        else if (mv.end.rank == 0 || mv.end.rank == 7)
+        {
+            int promo = 3; // queen unless a valid promotion piece is given
+            for (int k = 0; k < 4; ++k)
             {
-                setSqr(mv.end, pieceFlag, plrToMove);
+                if (promotionPieces[k] == pieceFlag)
+                    promo = k;
             }
-            
-            // switch player to move and reevaluate board
-            plrToMove = !plrToMove;
-            evaluateBoard(); // evaluates board (en passant moves already calculated)
+            flags |= PROMOTION | promo;
         }
     }
-    return cb;
+    else if (sqrPieces[start] == KING && diff.file == 2)
+    {
+        flags = CASTLE_KS;
+    }
+    else if (sqrPieces[start] == KING && diff.file == -2)
+    {
+        flags = CASTLE_QS;
+    }
+    return PackedMove(start, end, flags);
 }
 
-// [PRIVATE] returns ray generated by a move vector from a piece origin
-std::vector<GridVector> Board::castRay(GridVector origin, GridVector vec)
+// returns the piece for a letter of standard algebraic notation, PIECE_NULL if there is none
+static Piece sanPiece(char c)
+{
+    switch (c)
+    {
+        case 'K': return KING;
+        case 'Q': return QUEEN;
+        case 'R': return ROOK;
+        case 'B': return BISHOP;
+        case 'N': return KNIGHT;
+        default: return PIECE_NULL;
+    }
+}
+
+static const char sanLetters[6] = { 'P', 'R', 'N', 'B', 'Q', 'K' }; // by Piece
+static const char uciLetters[6] = { 'p', 'r', 'n', 'b', 'q', 'k' };
+
+// [PUBLIC] writes a valid move of the player to move in standard algebraic notation (e.g. Nbd7, exd6, e8=Q+, O-O#)
+// buf must hold SAN_BUFFER_SIZE chars, the string is zero terminated and its length returned
+int Board::toSAN(PackedMove mv, char* buf)
 {
-    std::vector<GridVector> ray = {};
-    bool stop = false;
-    int step = 1;
-    while (stop == false)
+    int n = 0;
+    int flags = mv.flags();
+    if (flags == CASTLE_KS || flags == CASTLE_QS)
+    {
+        const char* castle = (flags == CASTLE_KS) ? "O-O" : "O-O-O";
+        while (*castle)
+            buf[n++] = *castle++;
+    }
+    else
     {
-        if (validSqr(origin + vec*step) == true)
+        int start = mv.start();
+        Piece type = sqrPieces[start];
+        if (type == PAWN)
         {
-            ray.push_back(origin + vec*step);
-            step++;
+            if (mv.isCapture())
+                buf[n++] = 'a' + start % 8;
         }
         else
         {
-            stop = true;
+            buf[n++] = sanLetters[type];
+
+            // name the start file, else rank, else both if another piece of the same type can reach the end square
+            if (type != KING)
+            {
+                if (!raysEvaluated)
+                    evaluateRays();
+                MoveList others;
+                updateValidMoves(others, GEN_ALL, pieceBB[plrToMove][type] & ~sqrBB(start));
+
+                bool ambiguous = false;
+                bool sameFile = false;
+                bool sameRank = false;
+                for (auto other : others)
+                {
+                    if (other.end() == mv.end())
+                    {
+                        ambiguous = true;
+                        sameFile = sameFile || (other.start() % 8 == start % 8);
+                        sameRank = sameRank || (other.start() / 8 == start / 8);
+                    }
+                }
+                if (ambiguous && (!sameFile || sameRank))
+                    buf[n++] = 'a' + start % 8;
+                if (ambiguous && sameFile)
+                    buf[n++] = '1' + start / 8;
+            }
+        }
+        if (mv.isCapture())
+            buf[n++] = 'x';
+
+        buf[n++] = 'a' + mv.end() % 8;
+        buf[n++] = '1' + mv.end() / 8;
+        if (mv.isPromotion())
+        {
+            buf[n++] = '=';
+            buf[n++] = sanLetters[mv.promotion()];
         }
     }
-    return ray;
+
+    makeMove(mv);
+    if (getCheck() == plrToMove)
+        buf[n++] = hasAnyLegalMove() ? '+' : '#';
+    unmakeMove();
+
+    buf[n] = '\0';
+    return n;
 }
 
-// [PRIVATE] returns true if a square is covered by a player
-bool Board::isCoveredByPlr(GridVector sqr, Player plr)
+// [PUBLIC] parses a move in standard algebraic notation (e.g. Nbd7, exd6, e8=Q+, O-O) for the player to move
+// returns the null move unless the string names exactly one valid move, check marks and annotations are ignored
+PackedMove Board::fromSAN(std::string_view san)
 {
-    for (auto& cvr : sqrCoverage[ind(sqr)])
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?'))
+        san.remove_suffix(1);
+
+    MoveList mvs;
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0")
     {
-        if (cvr.owner == plr)
-            return true;
+        int flags = (san.size() == 3) ? CASTLE_KS : CASTLE_QS;
+        if (!attacksEvaluated)
+            evaluateAttacks();
+        updateValidMoves(mvs, GEN_ALL, pieceBB[plrToMove][KING]);
+        for (auto mv : mvs)
+        {
+            if (mv.flags() == flags)
+                return mv;
+        }
+        return PackedMove();
     }
-    return false;
+
+    Piece type = PAWN;
+    if (!san.empty() && sanPiece(san.front()) != PIECE_NULL)
+    {
+        type = sanPiece(san.front());
+        san.remove_prefix(1);
+    }
+
+    // promotion piece, the '=' is sometimes left out
+    Piece promo = PIECE_NULL;
+    if (san.size() > 2 && sanPiece(std::toupper(san.back())) != PIECE_NULL && (san[san.size() - 2] == '=' || std::isupper(san.back())))
+    {
+        promo = sanPiece(std::toupper(san.back()));
+        san.remove_suffix(1);
+        if (san.back() == '=')
+            san.remove_suffix(1);
+    }
+
+    if (san.size() < 2)
+        return PackedMove();
+    GridVector end(san[san.size() - 2] - 'a', san[san.size() - 1] - '1');
+    if (!validSqr(end))
+        return PackedMove();
+    san.remove_suffix(2);
+
+    // whatever is left is the capture mark and the start file and/or rank needed to tell pieces apart
+    int startFile = -1;
+    int startRank = -1;
+    for (char c : san)
+    {
+        if (c >= 'a' && c <= 'h')
+            startFile = c - 'a';
+        else if (c >= '1' && c <= '8')
+            startRank = c - '1';
+        else if (c != 'x' && c != ':')
+            return PackedMove();
+    }
+
+    // only the moves of pieces of the named type are generated
+    if (!raysEvaluated)
+        evaluateRays();
+    updateValidMoves(mvs, GEN_ALL, pieceBB[plrToMove][type]);
+
+    PackedMove found = PackedMove();
+    int numFound = 0;
+    for (auto mv : mvs)
+    {
+        if (mv.end() != ind(end) || mv.promotion() != promo)
+            continue;
+        if ((startFile >= 0 && mv.start() % 8 != startFile) || (startRank >= 0 && mv.start() / 8 != startRank))
+            continue;
+        found = mv;
+        numFound++;
+    }
+    return (numFound == 1) ? found : PackedMove();
 }
 
-// [PRIVATE] returns true if a square is covered by a player
-bool Board::isCaptureCoveredByPlr(GridVector sqr, Player plr, bool allowRayBndKing)
+// [PUBLIC] writes a move in UCI long algebraic notation (e.g. e2e4, e7e8q, 0000 for the null move)
+// buf must hold UCI_BUFFER_SIZE chars, the string is zero terminated and its length returned
+int Board::toUCI(PackedMove mv, char* buf)
 {
-    for (auto& cvr : sqrCoverage[ind(sqr)])
+    if (mv.isNull())
     {
-        if (cvr.owner == plr && (cvr.type == CAPTURE || cvr.type == PUSH_CAPTURE || (allowRayBndKing == true && cvr.type == RAY_BEYOND_KING)))
-            return true;
+        std::memcpy(buf, "0000", 5);
+        return 4;
     }
-    return false;
+
+    int n = 0;
+    buf[n++] = 'a' + mv.start() % 8;
+    buf[n++] = '1' + mv.start() / 8;
+    buf[n++] = 'a' + mv.end() % 8;
+    buf[n++] = '1' + mv.end() / 8;
+    if (mv.isPromotion())
+        buf[n++] = uciLetters[mv.promotion()];
+    buf[n] = '\0';
+    return n;
 }
 
-// [PRIVATE] returns player's pieces covering this square
-std::vector<SqrCover> Board::getCoversByPlr(GridVector sqr, Player plr)
+// [PUBLIC] parses a move in UCI long algebraic notation for the player to move, the null move if it is not valid
+PackedMove Board::fromUCI(std::string_view uci)
 {
-    std::vector<SqrCover> cvrs = {};
-    for (auto& cvr : sqrCoverage[ind(sqr)])
+    if (uci.size() < 4 || uci.size() > 5)
+        return PackedMove();
+
+    GridVector start(uci[0] - 'a', uci[1] - '1');
+    GridVector end(uci[2] - 'a', uci[3] - '1');
+    if (!validSqr(start) || !validSqr(end))
+        return PackedMove();
+
+    Piece promo = PIECE_NULL;
+    if (uci.size() == 5)
     {
-        if (cvr.owner == plr)
-            cvrs.push_back(cvr);
+        promo = sanPiece(std::toupper(uci[4]));
+        if (promo == PIECE_NULL || promo == KING)
+            return PackedMove();
     }
-    return cvrs;
+
+    // packMove would default a promotion without a piece to a queen, UCI always names it
+    PackedMove mv = packMove(Move(start, end), promo);
+    if (mv.promotion() != promo)
+        return PackedMove();
+    return isValidMove(mv) ? mv : PackedMove();
 }
 
-// [PRIVATE] returns true if a square is covered by another square
-bool Board::isCoveredBySqr(GridVector on, GridVector by)
+// [PUBLIC] executes a valid move and records what is needed to take it back
+void Board::makeMove(PackedMove mv)
 {
-    for (auto& cvr : sqrCoverage[ind(on)])
+    Move sqrMv = mv.toMove();
+    int flags = mv.flags();
+
+    UndoRecord undo;
+    undo.mv = mv;
+    undo.moved = sqrPieces[mv.start()];
+    undo.captured = (flags == ENPSSNT) ? PAWN : sqrPieces[mv.end()];
+    undo.enpssntSqr = enpssntSqr;
+    for (int p = WHITE; p <= BLACK; ++p)
     {
-        if (cvr.origin == by && (cvr.type == CAPTURE || cvr.type == PUSH_CAPTURE || cvr.type == RAY_BEYOND_KING))
-            return true;
+        undo.kingMoved[p] = kingMoved[p];
+        undo.rookKSMoved[p] = rookKSMoved[p];
+        undo.rookQSMoved[p] = rookQSMoved[p];
     }
-    return false;
+    undo.status = status;
+    undo.halfmoveClock = halfmoveClock;
+    undo.hashKey = hashKey;
+    undo.winner = winner;
+    int prevRights = castleRights();
+
+    int rank = (plrToMove == WHITE) ? 0 : 7;
+
+    // execute move, en passant and castling are executed in a special way
+    updateEnPssnt(sqrMv); // update en passant before executing move
+    if (flags == ENPSSNT)
+    {
+        executeEnPssnt(sqrMv);
+    }
+    else if (flags == CASTLE_KS)
+    {
+        executeCastleKS();
+    }
+    else if (flags == CASTLE_QS)
+    {
+        executeCastleQS();
+    }
+    else
+    {
+        executeMove(sqrMv);
+    }
+
+    // keep track of king being moved for first time for castling
+    if (undo.moved == KING)
+    {
+        kingMoved[plrToMove] = true;
+    }
+
+    // keep track of rook being moved for first time for castling
+    if (sqrMv.start == GridVector(7,rank) && rookKSMoved[plrToMove] == false)
+    {
+        rookKSMoved[plrToMove] = true;
+    }
+    else if (sqrMv.start == GridVector(0,rank) && rookQSMoved[plrToMove] == false)
+    {
+        rookQSMoved[plrToMove] = true;
+    }
+
+    // a rook captured on its starting square can no longer castle
+    if (sqrMv.end == GridVector(7,7 - rank))
+    {
+        rookKSMoved[opponent(plrToMove)] = true;
+    }
+    else if (sqrMv.end == GridVector(0,7 - rank))
+    {
+        rookQSMoved[opponent(plrToMove)] = true;
+    }
+
+    // replace a promoted pawn with the piece it promotes to
+    if (mv.isPromotion())
+    {
+        setSqr(sqrMv.end, mv.promotion(), plrToMove);
+    }
+
+    // clocks for the fifty move rule and move numbering
+    halfmoveClock = (undo.moved == PAWN || undo.captured != PIECE_NULL) ? 0 : halfmoveClock + 1;
+    if (plrToMove == BLACK)
+    {
+        fullmoveNumber++;
+    }
+
+    // pieces are hashed as they are placed, hash the change in flags and player to move
+    hashKey ^= zobrist.castling[prevRights] ^ zobrist.castling[castleRights()];
+    if (validSqr(undo.enpssntSqr))
+        hashKey ^= zobrist.enpssnt[undo.enpssntSqr.file];
+    if (validSqr(enpssntSqr))
+        hashKey ^= zobrist.enpssnt[enpssntSqr.file];
+    hashKey ^= zobrist.side;
+
+    undoStack.push_back(undo);
+    hashHistory.push_back(undo.hashKey);
+
+    // switch player to move, board is reevaluated when next queried
+    plrToMove = opponent(plrToMove);
+    raysEvaluated = false;
+    attacksEvaluated = false;
+    evaluated = false;
+}
+
+// [PUBLIC] as above for a square to square move, pieceFlag chooses the promotion piece (queen if not given)
+void Board::makeMove(Move mv, Piece pieceFlag)
+{
+    makeMove(packMove(mv, pieceFlag));
+}
+
+// [PUBLIC] takes back the last move made, restoring position and flags exactly
+void Board::unmakeMove()
+{
+    if (undoStack.empty())
+        return;
+
+    const UndoRecord& undo = undoStack.back();
+    Move sqrMv = undo.mv.toMove();
+    int flags = undo.mv.flags();
+    plrToMove = opponent(plrToMove);
+
+    int rank = (plrToMove == WHITE) ? 0 : 7;
+
+    // move the piece back (as it was before any promotion) and replace anything captured
+    clearSqr(sqrMv.end);
+    setSqr(sqrMv.start, undo.moved, plrToMove);
+    if (undo.captured != PIECE_NULL)
+    {
+        // the pawn taken en passant is beside the start square
+        GridVector capturedSqr = (flags == ENPSSNT) ? GridVector(sqrMv.end.file, sqrMv.start.rank) : sqrMv.end;
+        setSqr(capturedSqr, undo.captured, opponent(plrToMove));
+    }
+
+    if (undo.moved == KING)
+    {
+        kingSqr[plrToMove] = sqrMv.start;
+
+        // put back the rook of a castling move
+        if (flags == CASTLE_KS)
+        {
+            clearSqr({5,rank});
+            setSqr({7,rank}, ROOK, plrToMove);
+        }
+        else if (flags == CASTLE_QS)
+        {
+            clearSqr({3,rank});
+            setSqr({0,rank}, ROOK, plrToMove);
+        }
+    }
+
+    enpssntSqr = undo.enpssntSqr;
+    for (int p = WHITE; p <= BLACK; ++p)
+    {
+        kingMoved[p] = undo.kingMoved[p];
+        rookKSMoved[p] = undo.rookKSMoved[p];
+        rookQSMoved[p] = undo.rookQSMoved[p];
+    }
+    halfmoveClock = undo.halfmoveClock;
+    hashKey = undo.hashKey;
+    if (plrToMove == BLACK)
+    {
+        fullmoveNumber--;
+    }
+    status = undo.status;
+    winner = undo.winner;
+
+    undoStack.pop_back();
+    hashHistory.pop_back();
+    raysEvaluated = false;
+    attacksEvaluated = false;
+    evaluated = false;
+}
+
+// [PUBLIC]
+int Board::getUndoDepth()
+{
+    return undoStack.size();
+}
+
+// [PUBLIC] the record of a move made since the position was set up, lets callers replay the piece changes of a line
+const UndoRecord& Board::getUndoRecord(int i)
+{
+    return undoStack[i];
+}
+
+// [PRIVATE] returns true if a square is covered by a player
+bool Board::isCoveredByPlr(GridVector sqr, Player plr)
+{
+    return (sqrCoverage[plr] & sqrBB(ind(sqr))) != 0;
 }
 
 // [PRIVATE] returns true if piece on given sqr is pinned
 bool Board::isPinned(GridVector sqr)
 {
-    for (auto& pin : pinRays)
+    return (pinnedBB & sqrBB(ind(sqr))) != 0;
+}
+
+// [PRIVATE] returns the pieces of a player attacking a square, sliders are blocked by the given occupancy
+Bitboard Board::attackersTo(int ind, Player plr, Bitboard occ)
+{
+    return (pawnAttacks(opponent(plr), ind) & pieceBB[plr][PAWN])
+        | (knightAttacks(ind) & pieceBB[plr][KNIGHT])
+        | (kingAttacks(ind) & pieceBB[plr][KING])
+        | (bishopAttacks(ind, occ) & (pieceBB[plr][BISHOP] | pieceBB[plr][QUEEN]))
+        | (rookAttacks(ind, occ) & (pieceBB[plr][ROOK] | pieceBB[plr][QUEEN]));
+}
+
+// [PRIVATE] returns the squares from a set that the king of the player to move can step to without being attacked
+// uses the coverage if it is up to date, otherwise tests each square with the king lifted off the board so it cannot hide behind itself
+Bitboard Board::safeKingTargetsBB(Bitboard targets)
+{
+    if (attacksEvaluated)
+        return targets & ~sqrCoverage[opponent(plrToMove)];
+
+    Bitboard occ = allBB ^ pieceBB[plrToMove][KING];
+    Bitboard safe = 0;
+    while (targets)
     {
-        if (pin.on == sqr)
+        int i = popLsb(targets);
+        if (attackersTo(i, opponent(plrToMove), occ) == 0)
+            safe |= sqrBB(i);
+    }
+    return safe;
+}
+
+// [PRIVATE] returns true if an en passant move does not leave the player's own king in check
+// the capturing and captured pawns both leave the rank, so this is tested directly on the occupancy
+bool Board::isEnPssntLegal(Move mv)
+{
+    Player plr = getSqrOwner(mv.start);
+    int kingInd = lsb(pieceBB[plr][KING]);
+    int captured = ind(GridVector(mv.end.file, mv.start.rank));
+    Bitboard occ = (allBB ^ sqrBB(ind(mv.start)) ^ sqrBB(captured)) | sqrBB(ind(mv.end));
+    Bitboard enemyPawns = pieceBB[opponent(plr)][PAWN] & ~sqrBB(captured);
+
+    return ((rookAttacks(kingInd, occ) & (pieceBB[opponent(plr)][ROOK] | pieceBB[opponent(plr)][QUEEN])) == 0)
+        && ((bishopAttacks(kingInd, occ) & (pieceBB[opponent(plr)][BISHOP] | pieceBB[opponent(plr)][QUEEN])) == 0)
+        && ((knightAttacks(kingInd) & pieceBB[opponent(plr)][KNIGHT]) == 0)
+        && ((pawnAttacks(plr, kingInd) & enemyPawns) == 0);
+}
+
+// [PUBLIC] fills a move list with the valid moves of a type for the player to move, promotions are listed once per piece
+void Board::generateMoves(MoveList& mvs, MoveGenType type)
+{
+    if (!attacksEvaluated)
+        evaluateAttacks();
+
+    mvs.clear();
+    updateValidMoves(mvs, type, ~Bitboard(0));
+}
+
+// [PUBLIC] fills a move list with the captures and promotions for the player to move
+// only the check and pin rays are needed, so this skips building the square coverage
+void Board::generateCaptures(MoveList& mvs)
+{
+    if (!raysEvaluated)
+        evaluateRays();
+
+    mvs.clear();
+    updateValidMoves(mvs, GEN_CAPTURES, ~Bitboard(0));
+}
+
+// [PUBLIC] fills a move list with the moves out of check for the player to move, without building the square coverage
+// if the player is not in check this is the same as generateMoves
+void Board::generateEvasions(MoveList& mvs)
+{
+    if (!raysEvaluated)
+        evaluateRays();
+
+    if (check != plrToMove)
+    {
+        generateMoves(mvs);
+        return;
+    }
+
+    // castling is not allowed out of check, so the castle flags are not needed either
+    mvs.clear();
+    updateValidMoves(mvs, GEN_ALL, ~Bitboard(0));
+}
+
+// [PUBLIC] returns true if a move is valid for the player to move, only the moves of the piece being moved are generated
+bool Board::isValidMove(PackedMove mv)
+{
+    if (!raysEvaluated)
+        evaluateRays();
+    if ((mv.flags() == CASTLE_KS || mv.flags() == CASTLE_QS) && !attacksEvaluated)
+        evaluateAttacks();
+
+    if (sqrOwners[mv.start()] != plrToMove)
+        return false;
+
+    MoveList mvs;
+    updateValidMoves(mvs, GEN_ALL, sqrBB(mv.start()));
+    for (auto validMv : mvs)
+    {
+        if (validMv == mv)
             return true;
     }
     return false;
 }
 
-// [PUBLIC] returns number of valid moves for the player to move
-int Board::getNumValidMoves()
+// [PUBLIC] returns true if the player to move has a valid move, stopping at the first piece found with one
+bool Board::hasAnyLegalMove()
 {
-    int n = 0;
-    for (auto& mvs : validMoves)
+    if (!raysEvaluated)
+        evaluateRays();
+
+    int kingInd = lsb(pieceBB[plrToMove][KING]);
+    if (safeKingTargetsBB(kingAttacks(kingInd) & ~occupancyBB[plrToMove]))
+        return true;
+
+    // in double check only the king can move
+    if (popCount(checkersBB) > 1)
+        return false;
+
+    Bitboard checkMask = (check == plrToMove) ? (checkersBB | checkRays) : ~Bitboard(0);
+    Bitboard pieces = occupancyBB[plrToMove] & ~pieceBB[plrToMove][KING];
+    while (pieces)
+    {
+        if (pieceTargetsBB(popLsb(pieces), checkMask))
+            return true;
+    }
+
+    if (validSqr(enpssntSqr))
     {
-        n += mvs.size();
+        Bitboard takers = pawnAttacks(opponent(plrToMove), ind(enpssntSqr)) & pieceBB[plrToMove][PAWN];
+        while (takers)
+        {
+            if (isEnPssntLegal(Move(indSqr(popLsb(takers)), enpssntSqr)))
+                return true;
+        }
     }
-    return n;
+
+    // castling is never the only move, it needs the square beside the king to be empty and safe
+    return false;
 }
 
-// [PRIVATE] steps the system by clearing all previous data and recalculating position to get coverage of pieces, king threats, etc.
-void Board::evaluateBoard()
+// piece values for exchange evaluation indexed by Piece, the king outweighs anything it could be traded for
+static const int seeValues[7] = { 100, 500, 320, 330, 900, 20000, 0 };
+
+// [PUBLIC] static exchange evaluation, returns the material the player to move gains from a move and the exchange it starts on the end square
+// both sides recapture with their least valuable piece and may stop when continuing would lose material
+// sliders revealed behind pieces that have captured join in, pins are not considered
+int Board::see(PackedMove mv)
 {
-    // clear data
-    for (int i = 0; i < 8; ++i)
+    int start = mv.start();
+    int end = mv.end();
+    Player side = sqrOwners[start];
+
+    Bitboard occ = allBB ^ sqrBB(start);
+    Piece onSqr = mv.isPromotion() ? mv.promotion() : sqrPieces[start]; // piece that can be taken back next
+
+    int gain[32];
+    gain[0] = seeValues[sqrPieces[end]];
+    if (mv.flags() == ENPSSNT)
+    {
+        gain[0] = seeValues[PAWN];
+        occ ^= sqrBB(end - ((side == WHITE) ? 8 : -8));
+    }
+    if (mv.isPromotion())
+    {
+        gain[0] += seeValues[onSqr] - seeValues[PAWN];
+    }
+
+    Bitboard diagonals = pieceBB[WHITE][BISHOP] | pieceBB[BLACK][BISHOP] | pieceBB[WHITE][QUEEN] | pieceBB[BLACK][QUEEN];
+    Bitboard lines = pieceBB[WHITE][ROOK] | pieceBB[BLACK][ROOK] | pieceBB[WHITE][QUEEN] | pieceBB[BLACK][QUEEN];
+    Bitboard attackers = (attackersTo(end, WHITE, occ) | attackersTo(end, BLACK, occ)) & occ;
+
+    static const Piece captureOrder[6] = { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+    int depth = 0;
+    while (depth < 31)
     {
-        for (int j = 0; j < 8; ++j)
+        side = opponent(side);
+        Bitboard sideAttackers = attackers & occupancyBB[side];
+        if (sideAttackers == 0)
+            break;
+
+        // least valuable attacker
+        Piece piece = PIECE_NULL;
+        Bitboard from = 0;
+        for (Piece p : captureOrder)
         {
-            sqrCoverage[ind({i,j})].clear(); // refresh the coverage vectors for each square to update square coverage
-            validMoves[ind({i,j})].clear();
+            if (sideAttackers & pieceBB[side][p])
+            {
+                piece = p;
+                from = sideAttackers & pieceBB[side][p];
+                from &= -from;
+                break;
+            }
         }
-    }
-    check = PLAYER_NULL;
-    pinRays.clear();    
-    checkRays.clear();
 
-    // update the square coverage after a move to assess current position on board
-    updateSqrCoverage();
+        // the king can only take if nothing can take it back
+        if (piece == KING && (attackers & occupancyBB[opponent(side)]))
+            break;
+
+        // balance for this side if the exchange stops after it takes
+        depth++;
+        gain[depth] = seeValues[onSqr] - gain[depth - 1];
+
+        // lift the attacker and add any slider it was hiding
+        occ ^= from;
+        if (piece == PAWN || piece == BISHOP || piece == QUEEN)
+            attackers |= bishopAttacks(end, occ) & diagonals;
+        if (piece == ROOK || piece == QUEEN)
+            attackers |= rookAttacks(end, occ) & lines;
+        attackers &= occ;
+        onSqr = piece;
+    }
 
-    // determine if player to move is in check
-    if (isCoveredByPlr(kingSqr[plrToMove], !plrToMove))
+    // each side takes the better of stopping or continuing, working back from the end of the sequence
+    while (depth > 0)
     {
-        check = plrToMove;
+        gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+        depth--;
     }
+    return gain[0];
+}
+
+// [PUBLIC] returns number of valid moves for the player to move
+int Board::getNumValidMoves()
+{
+    MoveList mvs;
+    generateMoves(mvs);
+    return mvs.size;
+}
+
+// [PRIVATE] recalculates the pieces checking the king of the player to move and the pieces pinned against it
+void Board::evaluateRays()
+{
+    // clear data
+    raysEvaluated = true;
+    check = PLAYER_NULL;
+    checkRays = 0;
+    pinnedBB = 0;
+
+    // leaping checkers are found directly, sliding checkers are found along the king rays with the pins
+    int kingInd = lsb(pieceBB[plrToMove][KING]);
+    checkersBB = (knightAttacks(kingInd) & pieceBB[opponent(plrToMove)][KNIGHT]) | (pawnAttacks(plrToMove, kingInd) & pieceBB[opponent(plrToMove)][PAWN]);
 
     // update king rays for player to move (pinned rays, check rays)
     updateKingRays(ROOK); // file/rank rays
     updateKingRays(BISHOP); // diagonal rays
-    
+
+    if (checkersBB)
+    {
+        check = plrToMove;
+    }
+}
+
+// [PRIVATE] recalculates the coverage of pieces and castling for the position
+void Board::evaluateAttacks()
+{
+    if (!raysEvaluated)
+        evaluateRays();
+
+    attacksEvaluated = true;
+
+    // update the square coverage after a move to assess current position on board
+    updateSqrCoverage();
+
     updateCastle(); // update castle moves before updating valid moves (as this will be included)
+}
 
-    updateValidMoves(); // update valid moves for player to move
+// [PRIVATE] steps the system by recalculating the check rays of the position and the game status
+void Board::evaluateBoard()
+{
+    if (!raysEvaluated)
+        evaluateRays();
+
+    evaluated = true;
+    status = IN_PROGRESS; // a line made with makeMove may carry on past a draw
+    winner = PLAYER_NULL;
 
     // if no valid moves then game is over
-    if (getNumValidMoves() == 0)
+    if (!hasAnyLegalMove())
     {
         if (check == plrToMove)
         {
             // check mate
             status = CHECKMATE;
-            winner = !plrToMove;
+            winner = opponent(plrToMove);
         }
         else
         {
@@ -568,99 +2012,91 @@ void Board::evaluateBoard()
             status = STALEMATE;
         }
     }
+    else if (isFiftyMoveDraw() || isInsufficientMaterial() || getRepetitions() >= 2)
+    {
+        status = DRAW;
+    }
+}
+
+// [PRIVATE] returns the squares covered by the piece on a square, nothing for an empty square
+Bitboard Board::pieceCoverageBB(int ind)
+{
+    Player owner = sqrOwners[ind];
+    Bitboard occ = allBB;
+    if (owner != PLAYER_NULL)
+        occ &= ~pieceBB[opponent(owner)][KING]; // rays pass through the enemy king to find unsafe squares behind it
+
+    switch (sqrPieces[ind])
+    {
+        case PAWN:      return pawnAttacks(owner, ind);
+        case KNIGHT:    return knightAttacks(ind);
+        case BISHOP:    return bishopAttacks(ind, occ);
+        case ROOK:      return rookAttacks(ind, occ);
+        case QUEEN:     return bishopAttacks(ind, occ) | rookAttacks(ind, occ);
+        case KING:      return kingAttacks(ind);
+        default:        return 0;
+    }
 }
 
 // [PRIVATE] updates the coverage on each square by each players' pieces
+// a slider's coverage only changes if it reached a square whose occupancy changed, other pieces only change if they moved
 void Board::updateSqrCoverage()
 {
-    // iterate through each square of the board
-    for (int i = 0; i < 8; ++i) // file
+    Bitboard update = dirtyBB;
+    Bitboard sliders = (allBB & ~dirtyBB) & ~(pieceBB[WHITE][PAWN] | pieceBB[BLACK][PAWN] | pieceBB[WHITE][KNIGHT] | pieceBB[BLACK][KNIGHT] | pieceBB[WHITE][KING] | pieceBB[BLACK][KING]);
+    while (sliders)
     {
-        for (int j = 0; j < 8; ++j) // rank
-        {
-            if (!emptySqr({i,j})) // if the square in question is not empty, then examine the piece on the square
-            {
-                Piece piece = getSqrPiece({i,j});
-                Player owner = getSqrOwner({i,j});
+        int i = popLsb(sliders);
+        if (pieceCoverage[i] & dirtyBB)
+            update |= sqrBB(i);
+    }
+    dirtyBB = 0;
 
-                if (moveConstraint[piece] == true) // MOVE CONSTRAINED PIECE (Pawn, Knight, King)
-                {
-                    // PAWN
-                    if (piece == PAWN)
-                    {
-                        // get sign of pawn moves depending on player
-                        int sign = 1;
-                        if (owner == BLACK)
-                            sign = -1;
-                        
-                        // pawn push
-                        if ((validSqr(GridVector(i,j + sign))) && (getSqrOwner(GridVector(i,j + sign)) == PLAYER_NULL))
-                        {
-                            sqrCoverage[ind(GridVector(i,j + sign))].push_back({ {i,j}, piece, owner, PUSH });
-
-                            // double pawn push
-                            if ((((owner == WHITE) && (j == 1)) || ((owner == BLACK) && (j == 6))) && (validSqr(GridVector(i,j + 2*sign))) && (getSqrOwner(GridVector(i,j + 2*sign)) == PLAYER_NULL))
-                            {
-                                sqrCoverage[ind(GridVector(i,j + 2*sign))].push_back({ {i,j}, piece, owner, PUSH });
-                            }
-                        }
-
-                        // pawn capture
-                        if (validSqr(GridVector(i - 1,j + sign)))
-                        {
-                            sqrCoverage[ind(GridVector(i - 1,j + sign))].push_back({ {i,j}, piece, owner, CAPTURE });
-                        }
-                        if (validSqr(GridVector(i + 1,j + sign)))
-                        {
-                            sqrCoverage[ind(GridVector(i + 1,j + sign))].push_back({ {i,j}, piece, owner, CAPTURE });
-                        }
-                    }
-                    // KNIGHT / KING
-                    else
-                    {
-                        for (auto& vec : moveVectors[piece])
-                        {
-                            if (validSqr(GridVector(i,j) + vec))
-                            {
-                                sqrCoverage[ind(GridVector(i,j) + vec)].push_back({ {i,j}, piece, owner, PUSH_CAPTURE }); // the piece covers this square, add to coverage
-                            }
-                        }
-                    }
-                }
-                else // MOVE UNCONSTRAINED PIECE (ROOK, BISHOP, QUEEN)
-                {
-                    for (auto& vec : moveVectors[piece])
-                    {
-                        std::vector<GridVector> ray = castRay({i,j}, vec); // returns a vector of squares from origin in direction of move trajectory
-
-                        bool enemyKingInRay = false;
-                        for (auto& sqr : ray)
-                        {
-                            if (enemyKingInRay == false)
-                                sqrCoverage[ind(sqr)].push_back({ {i,j}, piece, owner, PUSH_CAPTURE });
-                            else
-                                sqrCoverage[ind(sqr)].push_back({ {i,j}, piece, owner, RAY_BEYOND_KING });
-                            
-                            if (getSqrOwner(sqr) != PLAYER_NULL)
-                            {
-                                if (sqr == kingSqr[!getSqrOwner({i,j})])
-                                {
-                                    enemyKingInRay = true; // if enemy king in ray then keep going to find unsafe squares behind king
-                                }
-                                else
-                                {
-                                    break; // stop loop if enemy/friendly piece enounctered on sqr in ray
-                                }
-                            }
-                            else if (enemyKingInRay == true)
-                            {
-                                break; // stop loop after going 1 square beyond enemy king
-                            }
-                        }
-                    }
-                }
-            }
+    while (update)
+    {
+        int i = popLsb(update);
+        pieceCoverage[i] = pieceCoverageBB(i);
+    }
+
+    // pawns are covered as a set by shifting, files stop pawns on the edge wrapping round the board
+    const Bitboard fileA = 0x0101010101010101ULL;
+    const Bitboard fileH = 0x8080808080808080ULL;
+    Bitboard whitePawns = pieceBB[WHITE][PAWN];
+    Bitboard blackPawns = pieceBB[BLACK][PAWN];
+    sqrCoverage[WHITE] = ((whitePawns & ~fileA) << 7) | ((whitePawns & ~fileH) << 9);
+    sqrCoverage[BLACK] = ((blackPawns & ~fileA) >> 9) | ((blackPawns & ~fileH) >> 7);
+
+    for (int p = WHITE; p <= BLACK; ++p)
+    {
+        Bitboard pieces = occupancyBB[p] & ~pieceBB[p][PAWN];
+        while (pieces)
+            sqrCoverage[p] |= pieceCoverage[popLsb(pieces)];
+    }
+
+#ifdef CHESSBOARD_DEBUG
+    checkSqrCoverage();
+#endif
+}
+
+// [PRIVATE] debug check that the incrementally updated coverage matches a rebuild from scratch, aborts if not
+void Board::checkSqrCoverage()
+{
+    Bitboard cvr[2] = { 0, 0 };
+    for (int i = 0; i < 64; ++i)
+    {
+        Bitboard expected = pieceCoverageBB(i);
+        if (pieceCoverage[i] != expected)
+        {
+            std::cerr << "Coverage mismatch for square " << indSqr(i) << " in " << toFEN() << std::endl;
+            std::abort();
         }
+        if (sqrOwners[i] != PLAYER_NULL)
+            cvr[sqrOwners[i]] |= expected;
+    }
+    if (cvr[WHITE] != sqrCoverage[WHITE] || cvr[BLACK] != sqrCoverage[BLACK])
+    {
+        std::cerr << "Player coverage mismatch in " << toFEN() << std::endl;
+        std::abort();
     }
 }
 
@@ -670,206 +2106,171 @@ void Board::updateSqrCoverage()
 // check rays need to be recorded to find the valid moves out of check that don't land the king back in check
 void Board::updateKingRays(Piece dirPiece)
 {
-    for (auto& vec : moveVectors[dirPiece]) // iterate through diagonal vectors
+    int kingInd = lsb(pieceBB[plrToMove][KING]);
+    Bitboard sliders = pieceBB[opponent(plrToMove)][dirPiece] | pieceBB[opponent(plrToMove)][QUEEN];
+    int firstDir = (dirPiece == ROOK) ? 0 : 4; // rook directions come first in the ray tables, then bishop directions
+
+    for (int d = firstDir; d < firstDir + 4; ++d)
     {
-        std::vector<GridVector> ray = castRay(kingSqr[plrToMove], vec);
+        Bitboard blockers = attackTables.ray[d][kingInd] & allBB;
+        if (blockers == 0)
+            continue;
 
-        bool stop = false;
-        int friendInRay = -1;
-        
-        for (int k = 0; k < ray.size(); ++k) // loop through squares in ray
-        {
-            if (getSqrOwner(ray[k]) == plrToMove)
-            {
-                // friendly piece in ray, if first piece encountered then record, else stop traversal
-                if (friendInRay > -1)
-                    stop = true;
-                else
-                    friendInRay = k;
-            }
-            else if (getSqrOwner(ray[k]) == !plrToMove && (getSqrPiece(ray[k]) == dirPiece || getSqrPiece(ray[k]) == QUEEN))
-            {
-                // get ray squares (squares between king and enemy piece)
-                std::vector<GridVector> raySqrs = {};
-                for (int l = 0; l <= k; ++l)
-                {
-                    raySqrs.push_back(ray[l]);
-                }
+        int first = rayPositive[d] ? lsb(blockers) : msb(blockers);
+        Bitboard raySqrs = attackTables.ray[d][kingInd] ^ attackTables.ray[d][first]; // squares between king and first piece, including the piece
 
-                if (friendInRay > -1)
-                {
-                    // if friend in ray then the friend is pinned
-                    pinRays.push_back({ray[friendInRay], ray[k], raySqrs});
-                }
-                else
-                {
-                    // if no friend in ray then this is a check ray
-                    checkRays.push_back({kingSqr[plrToMove], ray[k], raySqrs});
-                }
+        if (sliders & sqrBB(first))
+        {
+            // no piece between the king and enemy slider so this is a check ray
+            checkersBB |= sqrBB(first);
+            checkRays |= raySqrs;
+        }
+        else if (occupancyBB[plrToMove] & sqrBB(first))
+        {
+            // friendly piece in ray, it is pinned if the next piece along the ray is an enemy slider
+            Bitboard beyond = attackTables.ray[d][first] & allBB;
+            if (beyond == 0)
+                continue;
 
-                stop = true;
-            }
-            else if (getSqrOwner(ray[k]) == !plrToMove)
+            int second = rayPositive[d] ? lsb(beyond) : msb(beyond);
+            if (sliders & sqrBB(second))
             {
-                // non-threatening enemy piece in ray
-                stop = true;
+                pinnedBB |= sqrBB(first);
+                pinRays[first] = attackTables.ray[d][kingInd] ^ attackTables.ray[d][second];
             }
-
-            if (stop == true)
-                break;
         }
     }
 }
 
-// [PRIVATE]
-void Board::updateValidMoves()
+// [PRIVATE] returns the squares a piece other than the king can move to, en passant excluded
+// checkMask limits the targets to capturing or blocking a single checker
+Bitboard Board::pieceTargetsBB(int ind, Bitboard checkMask)
 {
-    if (check == plrToMove)
+    Bitboard targets = 0;
+    switch (sqrPieces[ind])
     {
-        // IN CHECK
-        // find ways to get out of check
-        std::vector<SqrCover> checkerCvrs = getCoversByPlr(kingSqr[plrToMove], !plrToMove); // get pieces that are checking the king
-        
-        // method 1 : move the king to a square that is not defended by enemy (including taking piece checking (if next to) or other enemy piece that isn't defended)
-        for (auto& vec : moveVectors[KING])
+        case PAWN:
         {
-            if (validSqr(kingSqr[plrToMove] + vec) && getSqrOwner(kingSqr[plrToMove] + vec) != plrToMove && (isCaptureCoveredByPlr(kingSqr[plrToMove] + vec, !plrToMove, true) == false))
+            int pawnDir = (plrToMove == WHITE) ? 8 : -8;
+            int pawnStartRank = (plrToMove == WHITE) ? 1 : 6;
+            if ((allBB & sqrBB(ind + pawnDir)) == 0)
             {
-                validMoves[ind(kingSqr[plrToMove])].push_back(Move(kingSqr[plrToMove], kingSqr[plrToMove] + vec));
+                targets |= sqrBB(ind + pawnDir);
+                if (ind / 8 == pawnStartRank && (allBB & sqrBB(ind + 2*pawnDir)) == 0)
+                    targets |= sqrBB(ind + 2*pawnDir);
             }
+            targets |= pawnAttacks(plrToMove, ind) & occupancyBB[opponent(plrToMove)];
+            break;
         }
-        if (checkerCvrs.size() == 1)
-        {
-            // method 2 : take the checking piece with something other than the king (if only 1 piece checking)
-            std::vector<SqrCover> cvrsOnChecker = getCoversByPlr(checkerCvrs[0].origin, plrToMove);
-            for (auto& cvr : cvrsOnChecker)
-            {
-                if (isPinned(cvr.origin) == false && (cvr.type == CAPTURE || cvr.type == PUSH_CAPTURE) && (cvr.piece != KING)) // a pinned piece cannot be pinned by the single checker of the king, can't be PUSH or RAY_BEYOND_KING
-                {
-                    validMoves[ind(cvr.origin)].push_back(Move(cvr.origin, checkerCvrs[0].origin));
-                }
-            }
+        case KNIGHT:
+            targets = knightAttacks(ind);
+            break;
+        case BISHOP:
+            targets = bishopAttacks(ind, allBB);
+            break;
+        case ROOK:
+            targets = rookAttacks(ind, allBB);
+            break;
+        case QUEEN:
+            targets = bishopAttacks(ind, allBB) | rookAttacks(ind, allBB);
+            break;
+        default:
+            break;
+    }
 
-            // method 3 : blocking the check if it originates from unconstrained piece (if only 1 piece checking)
-            // assume the size of the checkRay vector is at most 1 (otherwise there would be multiple checkers)
-            if (checkRays.size() == 1)
-            {
-                for (auto& sqr : checkRays[0].raySqrs)
-                {
-                    std::vector<SqrCover> blocksOnSqr = getCoversByPlr(sqr, plrToMove);
-                    for (auto& cvr : blocksOnSqr)
-                    {
-                        if (cvr.origin != kingSqr[plrToMove] && (cvr.type == PUSH || cvr.type == PUSH_CAPTURE)) // cannot be blocked by king itself
-                        {
-                            validMoves[ind(cvr.origin)].push_back(Move(cvr.origin, sqr));
-                        }
-                    }
-                }
-            }
-        }
-    }   
-    else
+    targets &= ~occupancyBB[plrToMove] & checkMask;
+
+    // pinned pieces can only move along the pin ray (including taking the pinning piece)
+    if (pinnedBB & sqrBB(ind))
+        targets &= pinRays[ind];
+
+    return targets;
+}
+
+// [PRIVATE] appends the valid moves of a type for pieces on the given squares, coverage, rays and castle flags must be up to date
+void Board::updateValidMoves(MoveList& mvs, MoveGenType type, Bitboard fromMask)
+{
+    int kingInd = lsb(pieceBB[plrToMove][KING]);
+    Bitboard own = occupancyBB[plrToMove];
+    Bitboard enemy = occupancyBB[opponent(plrToMove)];
+    Bitboard lastRank = (plrToMove == WHITE) ? 0xFF00000000000000ULL : 0x00000000000000FFULL;
+
+    // squares each type of move may land on, promotions are generated with the captures
+    Bitboard typeMask = (type == GEN_CAPTURES) ? enemy : (type == GEN_QUIETS) ? ~enemy : ~Bitboard(0);
+    Bitboard pawnTypeMask = (type == GEN_CAPTURES) ? (enemy | lastRank) : (type == GEN_QUIETS) ? (~enemy & ~lastRank) : ~Bitboard(0);
+
+    // the king can move to any square that is not occupied by a friend and not covered by the enemy
+    // enemy coverage is cast through the king so it cannot step back along a checking ray
+    if (fromMask & sqrBB(kingInd))
     {
-        // NOT IN CHECK, therefore iterate through all squares and record moves that cover this square by the player to move
-        // only calculate legal moves for non-king pieces that are NOT PINNED
-        for (int i = 0; i < 8; ++i)
+        Bitboard kingTargets = safeKingTargetsBB(kingAttacks(kingInd) & ~own & typeMask);
+        while (kingTargets)
         {
-            for (int j = 0; j < 8; ++j)
-            {
-                Piece piece = getSqrPiece({i,j});
-                Player owner = getSqrOwner({i,j});
-
-                if (owner != plrToMove) // make sure this square is not owned by plr to move (player to move cannot move piece to square it already occupies)
-                {
-                    for (auto& cvr : sqrCoverage[ind({i,j})])
-                    {
-                        if (cvr.owner == plrToMove && isPinned(cvr.origin) == false) // make sure this cover is owned by plr to move and is NOT PINNED
-                        {
-                            if (cvr.piece == PAWN)
-                            {
-                                if (owner == PLAYER_NULL && cvr.type == PUSH)
-                                {
-                                    // if pawn then push move only allowed if square empty
-                                    validMoves[ind(cvr.origin)].push_back(Move(cvr.origin, {i,j}));
-                                }
-                                else if (owner == !plrToMove && cvr.type == CAPTURE)
-                                {
-                                    // capture move only allowed if square occupied
-                                    validMoves[ind(cvr.origin)].push_back(Move(cvr.origin, {i,j}));
-                                }
-                            }
-                            else if (cvr.piece != KING)
-                            {
-                                // for all non-pawn pieces, the capture and push are coincidental
-                                validMoves[ind(cvr.origin)].push_back(Move(cvr.origin, {i,j}));
-                            }
-                        }
-                    }
-                }
-            }
+            int end = popLsb(kingTargets);
+            mvs.push(PackedMove(kingInd, end, (enemy & sqrBB(end)) ? CAPTURE : QUIET));
         }
+    }
+
+    // in double check only the king can move
+    if (popCount(checkersBB) > 1)
+        return;
+
+    // in single check the other pieces must capture the checker or block its ray
+    Bitboard checkMask = (check == plrToMove) ? (checkersBB | checkRays) : ~Bitboard(0);
+    int pawnDir = (plrToMove == WHITE) ? 8 : -8;
 
-        // calculate legal moves for player to move's king directly as it's more efficient than looking at cvrs by the king
-        for (auto& vec : moveVectors[KING])
+    Bitboard pieces = own & ~pieceBB[plrToMove][KING] & fromMask;
+    while (pieces)
+    {
+        int i = popLsb(pieces);
+        bool pawn = (sqrPieces[i] == PAWN);
+        Bitboard targets = pieceTargetsBB(i, checkMask) & (pawn ? pawnTypeMask : typeMask);
+
+        while (targets)
         {
-            if (validSqr(kingSqr[plrToMove] + vec))
+            int end = popLsb(targets);
+            int flags = (enemy & sqrBB(end)) ? CAPTURE : QUIET;
+
+            if (pawn && (lastRank & sqrBB(end)))
             {
-                if ((isCaptureCoveredByPlr(kingSqr[plrToMove] + vec, !plrToMove, false) == false) && getSqrOwner(kingSqr[plrToMove] + vec) != plrToMove)
-                {
-                    validMoves[ind(kingSqr[plrToMove])].push_back(Move(kingSqr[plrToMove], kingSqr[plrToMove] + vec));
-                }
+                // one move per promotion piece
+                for (int promo = 0; promo < 4; ++promo)
+                    mvs.push(PackedMove(i, end, flags | PROMOTION | promo));
             }
-        }
-
-        // calculate legal moves for pinned pieces, they can only move if they are moving to another square on the pin ray (including taking the pinning piece)
-        // note this code could be made more efficient by looking at piece types and going case by case
-        for (auto& pin : pinRays)
-        {
-            // iterate through each square in ray
-            for (auto& sqr : pin.raySqrs)
+            else if (pawn && (end - i == 2*pawnDir))
             {
-                // iterate through each cover if square
-                for (auto& cvr : sqrCoverage[ind(sqr)])
-                {
-                    if (cvr.origin == pin.on) // check this cover is owned by piece that is pinned
-                    {
-                        if (getSqrPiece(pin.on) == PAWN)
-                        {
-                            // if a pawn then must distinguish between capture and push
-                            if (getSqrOwner(sqr) == PLAYER_NULL && cvr.type == PUSH)
-                            {
-                                // if pawn then push move only allowed if square empty
-                                validMoves[ind(pin.on)].push_back(Move(pin.on, sqr));
-                            }
-                            else if (getSqrOwner(sqr) == !plrToMove && cvr.type == CAPTURE)
-                            {
-                                // capture move only allowed if square occupied
-                                validMoves[ind(pin.on)].push_back(Move(pin.on, sqr));
-                            }
-                        }
-                        else
-                        {
-                            validMoves[ind(pin.on)].push_back(Move(pin.on, sqr));
-                        }
-                    }
-                }
+                mvs.push(PackedMove(i, end, DOUBLE_PUSH));
+            }
+            else
+            {
+                mvs.push(PackedMove(i, end, flags));
             }
         }
+    }
 
-        // include en passant moves that are already calculated for the player to move
-        for (auto& mv : enpssntMoves)
+    // include en passant moves onto the square already calculated for the player to move
+    if (type != GEN_QUIETS && validSqr(enpssntSqr))
+    {
+        Bitboard takers = pawnAttacks(opponent(plrToMove), ind(enpssntSqr)) & pieceBB[plrToMove][PAWN] & fromMask;
+        while (takers)
         {
-            validMoves[ind(mv.start)].push_back(mv);
+            Move mv(indSqr(popLsb(takers)), enpssntSqr);
+            if (isEnPssntLegal(mv))
+                mvs.push(PackedMove(ind(mv.start), ind(mv.end), ENPSSNT));
         }
+    }
 
-        // include castling moves using the flags that have already been calculated
+    // include castling moves using the flags that have already been calculated, castling out of check is not allowed
+    // the flags are only up to date with the coverage, callers that skip it do not want castling moves
+    if (type != GEN_CAPTURES && attacksEvaluated && check != plrToMove && (fromMask & sqrBB(kingInd)))
+    {
         if (castleKSValid == true)
         {
-            validMoves[ind(kingSqr[plrToMove])].push_back(Move(kingSqr[plrToMove], kingSqr[plrToMove] + GridVector(2,0)));
+            mvs.push(PackedMove(kingInd, kingInd + 2, CASTLE_KS));
         }
         if (castleQSValid == true)
         {
-            validMoves[ind(kingSqr[plrToMove])].push_back(Move(kingSqr[plrToMove], kingSqr[plrToMove] + GridVector(-2,0)));
+            mvs.push(PackedMove(kingInd, kingInd - 2, CASTLE_QS));
         }
     }
 }
@@ -877,31 +2278,17 @@ void Board::updateValidMoves()
 // called just after move approved for execution but before it is executed and the plrToMove is changed
 void Board::updateEnPssnt(Move mv)
 {
-    enpssntMoves.clear(); // note en passant must be exercised immediately, clear all previous moves
+    enpssntSqr = GridVector(); // note en passant must be exercised immediately, clear any previous square
 
-    // check if there are new enpassant moves available with latest move
-    if (getSqrPiece(mv.start) == PAWN)
+    // check if an enemy pawn beside the end square can take this move en passant
+    if (getSqrPiece(mv.start) == PAWN && (mv.end - mv.start).file == 0 && ((mv.end - mv.start).rank == 2 || (mv.end - mv.start).rank == -2))
     {
-        if (plrToMove == WHITE && mv.start.rank == 1 && (mv.end - mv.start) == GridVector(0,2)) // if white double pawn push
+        for (int df = -1; df <= 1; df += 2)
         {
-            if (validSqr(mv.start + GridVector(1,2)) && getSqrPiece(mv.start + GridVector(1,2)) == PAWN && getSqrOwner(mv.start + GridVector(1,2)) == !plrToMove)
-            {
-                enpssntMoves.push_back(Move(mv.start + GridVector(1,2), mv.start + GridVector(0,1)));
-            }
-            else if (validSqr(mv.start + GridVector(-1,2)) && getSqrPiece(mv.start + GridVector(-1,2)) == PAWN && getSqrOwner(mv.start + GridVector(-1,2)) == !plrToMove)
+            GridVector side = mv.end + GridVector(df, 0);
+            if (validSqr(side) && getSqrPiece(side) == PAWN && getSqrOwner(side) == opponent(plrToMove))
             {
-                enpssntMoves.push_back(Move(mv.start + GridVector(-1,2), mv.start + GridVector(0,1)));
-            }
-        }
-        else if (plrToMove == BLACK && mv.start.rank == 6 && (mv.end - mv.start) == GridVector(0,-2)) // if black double pawn push
-        {
-            if (validSqr(mv.start + GridVector(1,-2)) && getSqrPiece(mv.start + GridVector(1,-2)) == PAWN && getSqrOwner(mv.start + GridVector(1,-2)) == !plrToMove)
-            {
-                enpssntMoves.push_back(Move(mv.start + GridVector(1,-2), mv.start + GridVector(0,-1)));
-            }
-            else if (validSqr(mv.start + GridVector(-1,-2)) && getSqrPiece(mv.start + GridVector(-1,-2)) == PAWN && getSqrOwner(mv.start + GridVector(-1,-2)) == !plrToMove)
-            {
-                enpssntMoves.push_back(Move(mv.start + GridVector(-1,-2), mv.start + GridVector(0,-1)));
+                enpssntSqr = GridVector(mv.start.file, (mv.start.rank + mv.end.rank) / 2);
             }
         }
     }
@@ -919,19 +2306,72 @@ void Board::updateCastle()
     {
         // king side castling
         if (rookKSMoved[plrToMove] == false && getSqrPiece({5,rank}) == PIECE_NULL && getSqrPiece({6,rank}) == PIECE_NULL 
-            && isCoveredByPlr({5,rank}, !plrToMove) == false && isCoveredByPlr({6,rank}, !plrToMove) == false)
+            && isCoveredByPlr({5,rank}, opponent(plrToMove)) == false && isCoveredByPlr({6,rank}, opponent(plrToMove)) == false)
         {
             castleKSValid = true;
         }
-        // queen side castling
-        if (rookKSMoved[plrToMove] == false && getSqrPiece({1,rank}) == PIECE_NULL && getSqrPiece({2,rank}) == PIECE_NULL && getSqrPiece({3,rank}) == PIECE_NULL
-            && isCoveredByPlr({1,rank}, !plrToMove) == false && isCoveredByPlr({2,rank}, !plrToMove) == false && isCoveredByPlr({3,rank}, !plrToMove) == false)
+        // queen side castling, the king does not cross the b-file square so only it needs to be empty
+        if (rookQSMoved[plrToMove] == false && getSqrPiece({1,rank}) == PIECE_NULL && getSqrPiece({2,rank}) == PIECE_NULL && getSqrPiece({3,rank}) == PIECE_NULL
+            && isCoveredByPlr({2,rank}, opponent(plrToMove)) == false && isCoveredByPlr({3,rank}, opponent(plrToMove)) == false)
         {
             castleQSValid = true;
         }
     }
 }
 
+/**************************************************************************************/
+// MOVE GENERATOR
+
+// [PUBLIC] the hash move is only returned if it is valid in the position
+MoveGenerator::MoveGenerator(Board& board, PackedMove hashMove) : board(board), hashMove(hashMove), stage(STAGE_HASH), index(0)
+{
+}
+
+// [PUBLIC] returns the next move, each stage is generated when the one before it is used up
+// the board may be moved in between calls as long as it is back in the same position
+PackedMove MoveGenerator::next()
+{
+    switch (stage)
+    {
+        case STAGE_HASH:
+            stage = STAGE_GEN_CAPTURES;
+            if (!hashMove.isNull() && board.isValidMove(hashMove))
+                return hashMove;
+            [[fallthrough]];
+
+        case STAGE_GEN_CAPTURES:
+            board.generateCaptures(mvs);
+            index = 0;
+            stage = STAGE_CAPTURES;
+            [[fallthrough]];
+
+        case STAGE_CAPTURES:
+            while (index < mvs.size)
+            {
+                PackedMove mv = mvs[index++];
+                if (mv != hashMove)
+                    return mv;
+            }
+            board.generateMoves(mvs, GEN_QUIETS);
+            index = 0;
+            stage = STAGE_QUIETS;
+            [[fallthrough]];
+
+        case STAGE_QUIETS:
+            while (index < mvs.size)
+            {
+                PackedMove mv = mvs[index++];
+                if (mv != hashMove)
+                    return mv;
+            }
+            stage = STAGE_DONE;
+            [[fallthrough]];
+
+        default:
+            return PackedMove();
+    }
+}
+
 } // namespace chessboard
 
 } // namespace gv
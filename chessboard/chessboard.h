@@ -8,6 +8,9 @@
 #include <unordered_map>
 #include <cstring>
 #include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
 
 namespace gv
 {
@@ -43,6 +46,7 @@ enum Player {
 
 std::ostream& operator<<(std::ostream& os, Player t);
 Player operator!(Player p);
+inline Player opponent(Player p) { return Player(1 - p); } // p must be WHITE or BLACK, safe for indexing per player arrays
 
 enum Status
 {
@@ -64,32 +68,95 @@ std::ostream& operator<<(std::ostream& os, Move mv);
 bool operator==(Move lh, Move rh);
 bool operator!=(Move lh, Move rh);
 
-enum CoverType
+// move kinds stored in the top 4 bits of a PackedMove
+// promotions set PROMOTION plus the piece (0 knight, 1 bishop, 2 rook, 3 queen), capturing moves set CAPTURE
+enum MoveFlag
 {
-    PUSH, CAPTURE, PUSH_CAPTURE, RAY_BEYOND_KING
+    QUIET = 0, DOUBLE_PUSH = 1, CASTLE_KS = 2, CASTLE_QS = 3, CAPTURE = 4, ENPSSNT = 5, PROMOTION = 8
 };
 
-struct SqrCover
+// 16 bit move, start square in bits 0-5, end square in bits 6-11 and MoveFlag in bits 12-15
+// square index = rank*8 + file, the all zero move (a1 to a1) is never valid and is used as the null move
+struct PackedMove
 {
-    GridVector origin;
-    Piece piece;
-    Player owner;
-    CoverType type;
+    std::uint16_t data;
+
+    PackedMove() = default; // uninitialised so move lists cost nothing to create, PackedMove() gives the null move
+    PackedMove(int start, int end, int flags) : data(std::uint16_t(start | (end << 6) | (flags << 12))) {}
+
+    int start() const { return data & 63; }
+    int end() const { return (data >> 6) & 63; }
+    int flags() const { return data >> 12; }
+    bool isNull() const { return data == 0; }
+    bool isCapture() const { return (flags() & CAPTURE) != 0; }
+    bool isPromotion() const { return (flags() & PROMOTION) != 0; }
+    Piece promotion() const; // PIECE_NULL if not a promotion
+    Move toMove() const;
+};
+
+std::ostream& operator<<(std::ostream& os, PackedMove mv);
+inline bool operator==(PackedMove lh, PackedMove rh) { return lh.data == rh.data; }
+inline bool operator!=(PackedMove lh, PackedMove rh) { return lh.data != rh.data; }
+
+// upper bound on the number of legal moves in any position
+const int MAX_MOVES = 256;
 
-    SqrCover() {}
-    SqrCover(GridVector origin, Piece piece, Player owner, CoverType type) : origin(origin), piece(piece), owner(owner), type(type) {}
+// buffer sizes for move notation including the terminating zero, the longest moves are like Qa1xb2# and e7e8q
+const int SAN_BUFFER_SIZE = 8;
+const int UCI_BUFFER_SIZE = 6;
+
+// which moves a generator produces, promotions count as captures so the two stages split the moves between them
+enum MoveGenType
+{
+    GEN_ALL, GEN_CAPTURES, GEN_QUIETS
 };
 
-struct Ray
+// fixed capacity move list that lives on the stack
+struct MoveList
 {
-    GridVector on;
-    GridVector by;
-    std::vector<GridVector> raySqrs;
+    PackedMove moves[MAX_MOVES];
+    int size;
+
+    MoveList() : size(0) {}
+
+    void push(PackedMove mv) { moves[size++] = mv; }
+    void clear() { size = 0; }
+    PackedMove& operator[](int i) { return moves[i]; }
+    PackedMove* begin() { return moves; }
+    PackedMove* end() { return moves + size; }
+};
+
+// one bit per square, bit index = rank*8 + file (a1 = 0, h8 = 63)
+typedef std::uint64_t Bitboard;
 
-    Ray() {}
-    Ray(GridVector on, GridVector by, std::vector<GridVector> raySqrs) : on(on), by(by), raySqrs(raySqrs) {}
+inline Bitboard sqrBB(int ind) { return Bitboard(1) << ind; }
+inline int popCount(Bitboard bb) { return __builtin_popcountll(bb); }
+inline int lsb(Bitboard bb) { return __builtin_ctzll(bb); }
+inline int msb(Bitboard bb) { return 63 - __builtin_clzll(bb); }
+inline int popLsb(Bitboard& bb) { int ind = lsb(bb); bb &= bb - 1; return ind; }
+
+// attacks from a square looked up in precomputed tables, sliders are blocked by the given occupancy
+Bitboard knightAttacks(int ind);
+Bitboard kingAttacks(int ind);
+Bitboard pawnAttacks(Player plr, int ind);
+Bitboard rookAttacks(int ind, Bitboard occ);
+Bitboard bishopAttacks(int ind, Bitboard occ);
+
+// midgame and endgame halves of an evaluation in centipawns, blended by the game phase
+struct TaperedScore
+{
+    int mg, eg;
 };
 
+inline TaperedScore operator+(TaperedScore lh, TaperedScore rh) { return { lh.mg + rh.mg, lh.eg + rh.eg }; }
+inline TaperedScore operator-(TaperedScore lh, TaperedScore rh) { return { lh.mg - rh.mg, lh.eg - rh.eg }; }
+inline TaperedScore operator*(TaperedScore lh, int rh) { return { lh.mg*rh, lh.eg*rh }; }
+inline TaperedScore& operator+=(TaperedScore& lh, TaperedScore rh) { lh.mg += rh.mg; lh.eg += rh.eg; return lh; }
+inline TaperedScore& operator-=(TaperedScore& lh, TaperedScore rh) { lh.mg -= rh.mg; lh.eg -= rh.eg; return lh; }
+
+// game phase of the starting material, knights and bishops count 1, rooks 2 and queens 4
+const int MAX_PHASE = 24;
+
 enum MoveCallback
 {
     SUCCESS, FAILURE
@@ -97,86 +164,222 @@ enum MoveCallback
 
 std::ostream& operator<<(std::ostream& os, MoveCallback t);
 
+// state needed to take back a move made with Board::makeMove
+struct UndoRecord
+{
+    PackedMove mv;
+    Piece moved;
+    Piece captured;
+    GridVector enpssntSqr;
+    bool kingMoved[2];
+    bool rookKSMoved[2];
+    bool rookQSMoved[2];
+    int halfmoveClock;
+    std::uint64_t hashKey;
+    Status status;
+    Player winner;
+};
+
+// compact snapshot of a position, trivially copyable so it can be memcpy'd, stored in flat arrays and passed between threads
+// squares hold a 4 bit code per square, two squares per byte with the lower square index in the low nibble
+// a code is 0 for an empty square, else 1 + piece + 6*owner
+struct Position
+{
+    std::uint8_t squares[32];
+    std::uint64_t hash; // zobrist key, as Board::hash
+    std::uint16_t halfmoveClock;
+    std::uint16_t fullmoveNumber;
+    std::uint8_t plrToMove;
+    std::uint8_t castling; // rights bit mask, white king side, white queen side, black king side, black queen side
+    std::uint8_t enpssntSqr; // square index, 64 if there is none
+
+    int code(int ind) const { return (squares[ind >> 1] >> ((ind & 1)*4)) & 15; }
+    Piece piece(int ind) const { return code(ind) ? Piece((code(ind) - 1) % 6) : PIECE_NULL; }
+    Player owner(int ind) const { return code(ind) ? Player((code(ind) - 1) / 6) : PLAYER_NULL; }
+    void set(int ind, Piece piece, Player owner)
+    {
+        int c = (piece == PIECE_NULL) ? 0 : 1 + piece + 6*owner;
+        squares[ind >> 1] = std::uint8_t((squares[ind >> 1] & ~(15 << ((ind & 1)*4))) | (c << ((ind & 1)*4)));
+    }
+};
+
+static_assert(std::is_trivially_copyable<Position>::value && sizeof(Position) <= 48, "Position must stay a small plain copyable struct");
+
 class Board
 {
 
 private:
-    std::vector<Piece> sqrPieces;
-    std::vector<Player> sqrOwners;
+    Piece sqrPieces[64];
+    Player sqrOwners[64];
 
-    // Static rules/assets
-    std::unordered_map<Piece, std::vector<GridVector>> moveVectors;
-    std::unordered_map<Piece, bool> moveConstraint;
+    // bitboards, kept in sync with sqrPieces/sqrOwners by setSqr/clearSqr
+    Bitboard pieceBB[2][6]; // [player][piece]
+    Bitboard occupancyBB[2]; // [player]
+    Bitboard allBB;
 
     // Flags
     Player plrToMove;
     Player winner;
     Status status;
     Player check;
-    std::unordered_map<Player, bool> kingMoved;
-    std::unordered_map<Player, bool> rookKSMoved;
-    std::unordered_map<Player, bool> rookQSMoved;
-    std::unordered_map<Player, GridVector> kingSqr;
-
-    // general square coverage (doesn't equate to legal moves!)
-    std::vector<std::vector<SqrCover>> sqrCoverage;
+    bool kingMoved[2];
+    bool rookKSMoved[2];
+    bool rookQSMoved[2];
+    GridVector kingSqr[2];
+    int halfmoveClock; // plies since the last pawn move or capture
+    int fullmoveNumber; // starts at 1 and increments after black moves
+    std::uint64_t hashKey; // zobrist key of the position, updated incrementally as pieces and flags change
+    std::uint64_t pawnKey; // zobrist key of the pawns alone, changes only when a pawn moves, is captured or promotes
+    TaperedScore psqtScore; // material plus piece-square score, white minus black, updated incrementally as pieces are placed and removed
+    int phase; // sum of the phase weights of the pieces on the board
+
+    // general square coverage per player (doesn't equate to legal moves!)
+    // rays of the covering player run through the enemy king, so squares behind a checked king stay unsafe
+    // kept up to date incrementally, only pieces on changed squares and sliders reaching them are recomputed
+    // build with CHESSBOARD_DEBUG defined to check every update against a full rebuild
+    Bitboard sqrCoverage[2];
+    Bitboard pieceCoverage[64]; // squares covered by the piece on each square, empty for empty squares
+    Bitboard dirtyBB; // squares whose occupancy changed since the coverage was last updated
     
     // rays
-    std::vector<Ray> pinRays;
-    std::vector<Ray> checkRays;
+    Bitboard checkersBB; // enemy pieces giving check to player to move
+    Bitboard checkRays; // squares between king and sliding checkers, including the checker
+    Bitboard pinnedBB; // pieces of player to move pinned against their king
+    Bitboard pinRays[64]; // for each pinned square, squares the pinned piece may still move to
 
-    std::vector<std::vector<Move>> validMoves; // stores all valid moves including special moves
 
     // special moves
-    std::vector<Move> enpssntMoves;
+    GridVector enpssntSqr; // square behind a pawn that can be taken en passant, invalid if none
     bool castleKSValid;
     bool castleQSValid;
 
+    bool raysEvaluated; // false while check, check rays and pins are out of date with the position
+    bool attacksEvaluated; // false while coverage and castle flags are out of date with the position
+    bool evaluated; // false while the status is out of date with the position
+    std::vector<UndoRecord> undoStack;
+    std::vector<std::uint64_t> hashHistory; // key of the position before each move on the undo stack, scanned for repetitions
+
 public:
     Board();
+    explicit Board(const Position& pos);
     void setup();
+    bool loadFEN(std::string_view fen);
+    std::string toFEN();
+    bool loadPosition(const Position& pos);
+    Position toPosition();
 
     Piece getSqrPiece(GridVector sqr);
+    Piece getSqrPiece(int ind);
     Player getSqrOwner(GridVector sqr);
+    Player getSqrOwner(int ind);
     bool emptySqr(GridVector sqr);
     bool validSqr(GridVector sqr);
+    Bitboard getPieceBB(Player plr, Piece piece);
+    Bitboard getOccupancyBB(Player plr);
 
     Player getCheck();
     Player getPlayerToMove();
     Status getStatus();
     Player getWinner();
+    int getHalfmoveClock();
+    int getFullmoveNumber();
+    std::uint64_t hash();
+    std::uint64_t pawnHash();
+    int getRepetitions(); // earlier occurrences of the position since the last pawn move or capture, 2 makes threefold
+    bool isRepetition(); // as getRepetitions() > 0, stops at the first match
+    bool isFiftyMoveDraw();
+    bool isInsufficientMaterial(); // no mate is possible, bare kings or a lone minor or bishops all on one colour
+    TaperedScore getPSQTScore();
+    int getPhase();
+    Bitboard getSqrCoverage(Player plr);
     std::vector<Move> getValidMoves(GridVector sqr);
+    void generateMoves(MoveList& mvs, MoveGenType type = GEN_ALL); // valid moves for the player to move, allocates nothing
+    void generateCaptures(MoveList& mvs); // captures and promotions, skips building the square coverage
+    void generateEvasions(MoveList& mvs); // moves out of check, skips building the square coverage
+    bool isValidMove(PackedMove mv);
+    bool hasAnyLegalMove();
     int getNumValidMoves();
+    int see(PackedMove mv); // material gained by a capture sequence on the move's end square, in centipawns
     
     MoveCallback requestMove(Move mv, Piece pieceFlag = PIECE_NULL); // note pieceFlag only required for pawn promotion
+
+    // make/unmake for search, the move must be valid for the player to move
+    // only the position and flags are updated, the board is reevaluated on demand when queried
+    void makeMove(PackedMove mv);
+    void makeMove(Move mv, Piece pieceFlag = PIECE_NULL);
+    void unmakeMove();
+    int getUndoDepth(); // number of moves that can be taken back
+    const UndoRecord& getUndoRecord(int i); // i = 0 is the oldest move that can be taken back
+
+    PackedMove packMove(Move mv, Piece pieceFlag = PIECE_NULL); // encodes a move in this position, pieceFlag defaults to queen for promotions
+
+    // move notation written into caller buffers, the to functions return the length written without the terminating zero
+    // the from functions return the null move unless the string is a valid move for the player to move
+    int toSAN(PackedMove mv, char* buf);
+    PackedMove fromSAN(std::string_view san);
+    static int toUCI(PackedMove mv, char* buf);
+    PackedMove fromUCI(std::string_view uci);
     
 private:
+    void evaluateRays();
+    void evaluateAttacks();
     void evaluateBoard();
 
     int ind(GridVector sqr);
     void setSqr(GridVector sqr, Piece type, Player owner);
     void clearSqr(GridVector sqr);
+    int castleRights();
+    std::uint64_t computeHash();
+    void fillBoard(const Piece* pieces, const Player* owners, Player toMove, int castling, GridVector epSqr, int halfmove, int fullmove);
+    void checkEvalState();
     void executeMove(Move mv);
     void executeEnPssnt(Move mv);
     void executeCastleKS();
     void executeCastleQS();
 
+    GridVector indSqr(int ind);
+
     bool isCoveredByPlr(GridVector sqr, Player plr);
-    bool isCaptureCoveredByPlr(GridVector sqr, Player plr, bool allowRayBndKing);
-    bool isCoveredBySqr(GridVector on, GridVector by);
     bool isPinned(GridVector sqr);
-    std::vector<SqrCover> getCoversByPlr(GridVector sqr, Player plr);
 
-    std::vector<GridVector> castRay(GridVector origin, GridVector dir);
+    Bitboard attackersTo(int ind, Player plr, Bitboard occ);
+    Bitboard safeKingTargetsBB(Bitboard targets);
+    bool isEnPssntLegal(Move mv);
 
+    Bitboard pieceCoverageBB(int ind);
     void updateSqrCoverage();
+    void checkSqrCoverage();
     void updateKingRays(Piece dirPiece);
-    void updateValidMoves();
+    Bitboard pieceTargetsBB(int ind, Bitboard checkMask);
+    void updateValidMoves(MoveList& mvs, MoveGenType type, Bitboard fromMask);
     void updateEnPssnt(Move mv);
     void updateCastle();
 
 };
 
+// hands out the valid moves of a position in stages, the hash move, then captures and promotions, then quiet moves
+// a stage is only generated once the previous one runs out, so callers that stop early never pay for the rest
+class MoveGenerator
+{
+
+private:
+    enum Stage
+    {
+        STAGE_HASH, STAGE_GEN_CAPTURES, STAGE_CAPTURES, STAGE_QUIETS, STAGE_DONE
+    };
+
+    Board& board;
+    PackedMove hashMove;
+    Stage stage;
+    MoveList mvs;
+    int index;
+
+public:
+    MoveGenerator(Board& board, PackedMove hashMove = PackedMove());
+
+    PackedMove next(); // null move once every move has been returned
+};
+
 } // namespace chessboard
 
 } // namespace gv
@@ -0,0 +1,151 @@
+#include "../../book/book.h"
+#include "../../pgn/pgn.h"
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+using namespace gv;
+
+/**************************************************************************************************************/
+// PROBING
+
+// prints a position's book moves with their weights and the chance of each being picked
+static int probeBook(book::Book& bk, const std::string& fen)
+{
+    chessboard::Board board;
+    if (board.loadFEN(fen) == false)
+    {
+        std::cerr << "invalid fen " << fen << std::endl;
+        return 1;
+    }
+
+    book::BookEntry entries[book::MAX_BOOK_MOVES];
+    chessboard::PackedMove mvs[book::MAX_BOOK_MOVES];
+    int n = bk.probe(board, entries, mvs);
+    std::cout << fen << ": key " << std::hex << bk.getKeys().key(board) << std::dec << "  " << n << " moves" << std::endl;
+
+    long long total = 0;
+    for (int i = 0; i < n; ++i)
+        total += entries[i].weight;
+    for (int i = 0; i < n; ++i)
+    {
+        char san[chessboard::SAN_BUFFER_SIZE];
+        board.toSAN(mvs[i], san);
+        std::cout << "  " << san << "  weight " << entries[i].weight << "  " << 100.0*entries[i].weight/std::max(total, 1LL) << "%" << std::endl;
+    }
+    return n > 0 ? 0 : 1;
+}
+
+/**************************************************************************************************************/
+// MAIN
+
+static void printUsage()
+{
+    std::cout << "usage: mkbook [-plies n] [-min n] [-threads n] [-keys file] -o book.bin file.pgn ..." << std::endl;
+    std::cout << "       mkbook [-keys file] -probe book.bin fen" << std::endl;
+    std::cout << "builds a Polyglot book from the first n plies (default 24) of every decisive or drawn game, keeping moves" << std::endl;
+    std::cout << "played in at least min games (default 1), keyed with the standard Polyglot random numbers, -keys loads" << std::endl;
+    std::cout << "781 other numbers from a text file for books made with their own table" << std::endl;
+    std::cout << "-probe prints the book moves of a position" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int maxPlies = 24;
+    int minGames = 1;
+    int numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+    std::string keysPath;
+    std::string outPath;
+    std::string probePath;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-plies" && i + 1 < argc)
+            maxPlies = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "-min" && i + 1 < argc)
+            minGames = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "-threads" && i + 1 < argc)
+            numThreads = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "-keys" && i + 1 < argc)
+            keysPath = argv[++i];
+        else if (arg == "-o" && i + 1 < argc)
+            outPath = argv[++i];
+        else if (arg == "-probe" && i + 1 < argc)
+            probePath = argv[++i];
+        else if (arg[0] != '-')
+            files.push_back(arg);
+        else
+        {
+            printUsage();
+            return (arg == "-h" || arg == "-help") ? 0 : 1;
+        }
+    }
+
+    book::PolyglotKeys keys;
+    if (keysPath.empty() == false && keys.load(keysPath) == false)
+    {
+        std::cerr << "could not read 781 keys from " << keysPath << std::endl;
+        return 1;
+    }
+    if (keys.isStandard() == false)
+        std::cerr << "note: not using the standard Polyglot keys, books will only match tools using the same numbers" << std::endl;
+
+    if (probePath.empty() == false)
+    {
+        book::Book bk;
+        if (files.size() != 1 || bk.open(probePath) == false)
+        {
+            std::cerr << "could not open " << probePath << std::endl;
+            return 1;
+        }
+        bk.getKeys() = keys;
+        return probeBook(bk, files[0]);
+    }
+
+    if (outPath.empty() || files.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    long long totalGames = 0;
+    book::BookBuilder builder;
+    std::mutex builderMutex;
+    for (auto& path : files)
+    {
+        pgn::MappedFile file;
+        if (file.open(path) == false)
+        {
+            std::cerr << "could not open " << path << std::endl;
+            return 1;
+        }
+        std::vector<std::string_view> games = pgn::splitGames(file.view());
+        totalGames += games.size();
+
+        pgn::replayGames(games, numThreads, [&](std::size_t, const pgn::Game& game, chessboard::Board& board)
+        {
+            // the game's keys are worked out on its own thread, only the merge is shared
+            book::BookBuilder local;
+            board.loadFEN(game.startFEN);
+            local.addGame(board, keys, game.moves, game.result, maxPlies);
+
+            std::lock_guard<std::mutex> lock(builderMutex);
+            builder.add(local);
+        });
+    }
+
+    std::size_t played = builder.size();
+    long long written = builder.save(outPath, minGames);
+    if (written < 0)
+    {
+        std::cerr << "could not write " << outPath << std::endl;
+        return 1;
+    }
+    double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "games " << totalGames << "  moves " << played << "  entries " << written << "  time " << time << " s" << std::endl;
+    return 0;
+}
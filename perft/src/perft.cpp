@@ -0,0 +1,199 @@
+#include "../../chessboard/chessboard.h"
+#include <chrono>
+#include <cstdlib>
+
+using namespace gv;
+
+/**************************************************************************************************************/
+// REFERENCE POSITIONS
+
+// counts[d-1] is the number of leaf nodes at depth d
+struct RefPosition
+{
+    std::string name;
+    std::string fen;
+    std::vector<long long> counts;
+};
+
+static const std::string startFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// standard perft positions, between them they cover castling, en passant, promotions, pins and discovered checks
+static const std::vector<RefPosition> refPositions = {
+    { "Initial position", startFEN,
+        { 20, 400, 8902, 197281, 4865609, 119060324 } },
+    { "Kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        { 48, 2039, 97862, 4085603, 193690690 } },
+    { "Position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        { 14, 191, 2812, 43238, 674624, 11030083 } },
+    { "Position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        { 6, 264, 9467, 422333, 15833292 } },
+    { "Position 4 (mirrored)", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+        { 6, 264, 9467, 422333, 15833292 } },
+    { "Position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        { 44, 1486, 62379, 2103487, 89941194 } },
+    { "Position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        { 46, 2079, 89890, 3894594, 164075551 } },
+};
+
+/**************************************************************************************************************/
+// PERFT
+
+// counts leaf nodes to the given depth, move lists live on the stack so the count itself does not allocate
+static long long perft(chessboard::Board& board, int depth)
+{
+    chessboard::MoveList mvs;
+    board.generateMoves(mvs);
+
+    // bulk count the last ply without making the moves
+    if (depth == 1)
+        return mvs.size;
+
+    long long nodes = 0;
+    for (auto mv : mvs)
+    {
+        board.makeMove(mv);
+        nodes += perft(board, depth - 1);
+        board.unmakeMove();
+    }
+    return nodes;
+}
+
+// prints the node count below each root move before returning the total
+static long long divide(chessboard::Board& board, int depth)
+{
+    chessboard::MoveList rootMoves;
+    board.generateMoves(rootMoves);
+
+    long long nodes = 0;
+    for (auto mv : rootMoves)
+    {
+        board.makeMove(mv);
+        long long n = (depth > 1) ? perft(board, depth - 1) : 1;
+        board.unmakeMove();
+
+        char str[chessboard::UCI_BUFFER_SIZE];
+        chessboard::Board::toUCI(mv, str);
+        std::cout << str << ": " << n << std::endl;
+        nodes += n;
+    }
+    return nodes;
+}
+
+// runs perft for depths 1..maxDepth and reports nodes and speed for each, returns false on a mismatch with expected counts
+static bool runPerft(chessboard::Board& board, int maxDepth, bool showDivide, const std::vector<long long>& counts)
+{
+    bool pass = true;
+    for (int depth = 1; depth <= maxDepth; ++depth)
+    {
+        auto start = std::chrono::steady_clock::now();
+        long long nodes = (showDivide && depth == maxDepth) ? divide(board, depth) : perft(board, depth);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "depth " << depth << "  nodes " << nodes << "  time " << secs << " s  nps " << (long long)(nodes / std::max(secs, 1e-9));
+        if (depth <= (int)counts.size())
+        {
+            bool ok = (nodes == counts[depth - 1]);
+            std::cout << "  " << (ok ? "OK" : "FAIL (expected " + std::to_string(counts[depth - 1]) + ")");
+            pass = pass && ok;
+        }
+        std::cout << std::endl;
+    }
+    return pass;
+}
+
+static bool applyMoves(chessboard::Board& board, const std::vector<std::string>& moves)
+{
+    for (auto& str : moves)
+    {
+        chessboard::PackedMove mv = board.fromUCI(str);
+        if (mv.isNull())
+        {
+            std::cerr << "Invalid move: " << str << std::endl;
+            return false;
+        }
+        board.makeMove(mv);
+    }
+    return true;
+}
+
+/**************************************************************************************************************/
+// MAIN
+
+static void printUsage()
+{
+    std::cout << "usage: perft [-d depth] [-divide] [-fen \"<fen>\"] [moves...]" << std::endl;
+    std::cout << "       perft -suite [-d maxDepth]" << std::endl;
+    std::cout << "moves are long algebraic coordinates applied from the position (initial position by default) e.g. e2e4 e7e5" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int depth = -1;
+    bool showDivide = false;
+    bool suite = false;
+    std::string fen = startFEN;
+    std::vector<std::string> moves;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-d" && i + 1 < argc)
+        {
+            depth = std::atoi(argv[++i]);
+        }
+        else if (arg == "-fen" && i + 1 < argc)
+        {
+            fen = argv[++i];
+        }
+        else if (arg == "-divide")
+        {
+            showDivide = true;
+        }
+        else if (arg == "-suite")
+        {
+            suite = true;
+        }
+        else if (arg == "-h" || arg == "-help")
+        {
+            printUsage();
+            return 0;
+        }
+        else
+        {
+            moves.push_back(arg);
+        }
+    }
+
+    if (suite)
+    {
+        // the full reference depths take minutes, by default stop at depth 5 unless asked for more
+        int maxDepth = (depth > 0) ? depth : 5;
+        bool pass = true;
+        for (auto& ref : refPositions)
+        {
+            std::cout << ref.name << std::endl;
+            chessboard::Board board;
+            if (board.loadFEN(ref.fen) == false)
+            {
+                std::cerr << "Invalid FEN: " << ref.fen << std::endl;
+                pass = false;
+                continue;
+            }
+            pass = runPerft(board, std::min(maxDepth, (int)ref.counts.size()), false, ref.counts) && pass;
+        }
+        std::cout << (pass ? "All reference counts match" : "Reference count mismatch") << std::endl;
+        return pass ? 0 : 1;
+    }
+
+    chessboard::Board board;
+    if (board.loadFEN(fen) == false)
+    {
+        std::cerr << "Invalid FEN: " << fen << std::endl;
+        return 1;
+    }
+    if (applyMoves(board, moves) == false)
+        return 1;
+
+    runPerft(board, (depth > 0) ? depth : 5, showDivide, {});
+    return 0;
+}
@@ -0,0 +1,312 @@
+#include "pgn.h"
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gv
+{
+namespace pgn
+{
+
+/**************************************************************************************/
+// MAPPED FILE
+
+// [PUBLIC]
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+// [PUBLIC] maps the whole file, an empty file maps to an empty view
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    if (st.st_size > 0)
+    {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        madvise(addr, st.st_size, MADV_SEQUENTIAL); // games are split front to back
+        data = (const char*)addr;
+        size = st.st_size;
+    }
+    ::close(fd); // the mapping keeps the file open
+    return true;
+}
+
+// [PUBLIC]
+void MappedFile::close()
+{
+    if (data)
+        munmap((void*)data, size);
+    data = nullptr;
+    size = 0;
+}
+
+// [PUBLIC]
+std::string_view MappedFile::view() const
+{
+    return std::string_view(data, size);
+}
+
+/**************************************************************************************/
+// GAME SPLITTING
+
+// [PUBLIC] a game starts at a tag line that follows movetext, so tags and movetext of one game stay together
+std::vector<std::string_view> splitGames(std::string_view text)
+{
+    std::vector<std::string_view> games;
+    std::size_t gameStart = std::string_view::npos;
+    bool inMovetext = false;
+    int braceDepth = 0; // comments may run over several lines and contain '['
+
+    std::size_t pos = 0;
+    while (pos < text.size())
+    {
+        std::size_t lineEnd = text.find('\n', pos);
+        if (lineEnd == std::string_view::npos)
+            lineEnd = text.size();
+        std::string_view line = text.substr(pos, lineEnd - pos);
+
+        std::size_t first = line.find_first_not_of(" \t\r");
+        if (first != std::string_view::npos)
+        {
+            if (braceDepth == 0 && line[first] == '[')
+            {
+                if (inMovetext && gameStart != std::string_view::npos)
+                    games.push_back(text.substr(gameStart, pos - gameStart));
+                if (inMovetext || gameStart == std::string_view::npos)
+                    gameStart = pos;
+                inMovetext = false;
+            }
+            else if (braceDepth > 0 || line[first] != '%') // '%' lines are escaped and ignored
+            {
+                if (gameStart == std::string_view::npos)
+                    gameStart = pos; // movetext without tags
+                inMovetext = true;
+                for (char c : line)
+                {
+                    if (c == '{')
+                        braceDepth++;
+                    else if (c == '}' && braceDepth > 0)
+                        braceDepth--;
+                    else if (c == ';' && braceDepth == 0)
+                        break; // rest of line comment
+                }
+            }
+        }
+        pos = lineEnd + 1;
+    }
+
+    if (gameStart != std::string_view::npos && gameStart < text.size())
+        games.push_back(text.substr(gameStart));
+    return games;
+}
+
+/**************************************************************************************/
+// GAME PARSING
+
+static const std::string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static bool isResult(std::string_view token)
+{
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+// [PUBLIC]
+std::string_view Game::tag(std::string_view name) const
+{
+    for (auto& t : tags)
+    {
+        if (t.name == name)
+            return t.value;
+    }
+    return std::string_view();
+}
+
+// parses a tag line [Name "Value"], returns false if it is malformed
+static bool parseTag(std::string_view line, TagPair& tag)
+{
+    std::size_t open = line.find('[');
+    std::size_t nameEnd = line.find_first_of(" \t", open);
+    std::size_t quote = line.find('"', open);
+    if (open == std::string_view::npos || nameEnd == std::string_view::npos || quote == std::string_view::npos)
+        return false;
+
+    std::size_t close = quote + 1;
+    while (close < line.size() && line[close] != '"')
+    {
+        close += (line[close] == '\\') ? 2 : 1;
+    }
+    if (close >= line.size())
+        return false;
+
+    tag.name = line.substr(open + 1, nameEnd - open - 1);
+    tag.value = line.substr(quote + 1, close - quote - 1);
+    return true;
+}
+
+// [PUBLIC]
+bool parseGame(std::string_view text, Game& game, chessboard::Board& board)
+{
+    game.tags.clear();
+    game.result = std::string_view();
+    game.startFEN = START_FEN;
+    game.moves.clear();
+    game.ok = true;
+    game.error.clear();
+
+    auto fail = [&](const std::string& error)
+    {
+        game.ok = false;
+        game.error = error;
+        return false;
+    };
+
+    // tag section
+    std::size_t pos = 0;
+    while (pos < text.size())
+    {
+        std::size_t lineEnd = text.find('\n', pos);
+        if (lineEnd == std::string_view::npos)
+            lineEnd = text.size();
+        std::string_view line = text.substr(pos, lineEnd - pos);
+        std::size_t first = line.find_first_not_of(" \t\r");
+        if (first != std::string_view::npos && line[first] != '[')
+            break;
+
+        TagPair tag;
+        if (first != std::string_view::npos && parseTag(line, tag))
+            game.tags.push_back(tag);
+        pos = lineEnd + 1;
+    }
+
+    std::string_view fen = game.tag("FEN");
+    if (fen.empty() == false)
+        game.startFEN = std::string(fen);
+    if (board.loadFEN(game.startFEN) == false)
+        return fail("invalid FEN tag");
+
+    // movetext, only the main line is replayed
+    int variationDepth = 0;
+    while (pos < text.size())
+    {
+        char c = text[pos];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '.')
+        {
+            pos++;
+        }
+        else if (c == '{')
+        {
+            std::size_t close = text.find('}', pos);
+            pos = (close == std::string_view::npos) ? text.size() : close + 1;
+        }
+        else if (c == ';' || c == '%')
+        {
+            std::size_t lineEnd = text.find('\n', pos);
+            pos = (lineEnd == std::string_view::npos) ? text.size() : lineEnd + 1;
+        }
+        else if (c == '(')
+        {
+            variationDepth++;
+            pos++;
+        }
+        else if (c == ')')
+        {
+            variationDepth = std::max(variationDepth - 1, 0);
+            pos++;
+        }
+        else
+        {
+            std::size_t end = text.find_first_of(" \t\r\n{}();", pos);
+            if (end == std::string_view::npos)
+                end = text.size();
+            std::string_view token = text.substr(pos, end - pos);
+            pos = end;
+
+            if (variationDepth > 0 || token[0] == '$')
+                continue; // variation moves and numeric annotation glyphs
+
+            if (isResult(token))
+            {
+                game.result = token;
+                break;
+            }
+
+            // move numbers, possibly run into the move as in "12.e4" or "12...Nf6"
+            // only digits followed by dots are a number, so castling written with zeros as "0-0" is kept
+            std::size_t digitsEnd = token.find_first_not_of("0123456789");
+            if (digitsEnd == std::string_view::npos)
+                continue;
+            if (token[digitsEnd] == '.')
+            {
+                std::size_t moveStart = token.find_first_not_of('.', digitsEnd);
+                if (moveStart == std::string_view::npos)
+                    continue;
+                token.remove_prefix(moveStart);
+            }
+
+            chessboard::PackedMove mv = board.fromSAN(token);
+            if (mv.isNull())
+                return fail("invalid move " + std::string(token) + " at ply " + std::to_string(game.moves.size() + 1));
+            board.makeMove(mv);
+            game.moves.push_back(mv);
+        }
+    }
+
+    if (game.result.empty())
+        game.result = game.tag("Result");
+    return true;
+}
+
+/**************************************************************************************/
+// PARALLEL REPLAY
+
+// [PUBLIC] games are handed out one at a time through a shared counter, so uneven game lengths balance out
+void replayGames(const std::vector<std::string_view>& games, int numThreads, GameCallback onGame)
+{
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]()
+    {
+        chessboard::Board board;
+        Game game;
+        for (std::size_t i = next.fetch_add(1); i < games.size(); i = next.fetch_add(1))
+        {
+            parseGame(games[i], game, board);
+            onGame(i, game, board);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; ++t)
+    {
+        threads.emplace_back(worker);
+    }
+    worker(); // the calling thread works too
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+} // namespace pgn
+
+} // namespace gv
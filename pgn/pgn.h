@@ -0,0 +1,68 @@
+/* PGN reading and parallel game replay */
+#pragma once
+
+#include "../chessboard/chessboard.h"
+#include <functional>
+
+namespace gv
+{
+
+namespace pgn
+{
+
+// read only memory mapping of a whole file, pages are read in by the OS as they are touched
+class MappedFile
+{
+
+private:
+    const char* data;
+    std::size_t size;
+
+public:
+    MappedFile() : data(nullptr), size(0) {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool open(const std::string& path); // false if the file can't be opened or mapped
+    void close();
+
+    std::string_view view() const; // empty if nothing is mapped
+};
+
+// returns the text of each game, from its first tag to the end of its movetext, no copies are made
+std::vector<std::string_view> splitGames(std::string_view text);
+
+struct TagPair
+{
+    std::string_view name;
+    std::string_view value; // as written, escaped quotes are left escaped
+};
+
+// a game parsed and replayed from PGN, the views point into the PGN text
+struct Game
+{
+    std::vector<TagPair> tags;
+    std::string_view result; // "1-0", "0-1", "1/2-1/2" or "*", from the movetext or else the Result tag
+    std::string startFEN; // starting position, from the FEN tag if there is one
+    std::vector<chessboard::PackedMove> moves; // the main line, variations are skipped
+    bool ok;
+    std::string error; // first error, the moves before it are kept
+
+    std::string_view tag(std::string_view name) const; // empty if the game has no such tag
+};
+
+// parses one game's text and replays its main line on a board to turn each SAN move into a move
+// the board is left in the final position, returns game.ok
+bool parseGame(std::string_view text, Game& game, chessboard::Board& board);
+
+// called once for each game by the thread that replayed it, games finish in no particular order
+// board holds the game's final position, the callback must be safe to call from several threads at once
+typedef std::function<void(std::size_t index, const Game& game, chessboard::Board& board)> GameCallback;
+
+// parses and replays games on a pool of threads, each takes the next unclaimed game until none are left
+void replayGames(const std::vector<std::string_view>& games, int numThreads, GameCallback onGame);
+
+} // namespace pgn
+
+} // namespace gv
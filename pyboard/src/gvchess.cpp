@@ -0,0 +1,408 @@
+/* Python extension exposing chessboard::Board, built against the CPython API so it needs no other packages */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "../../chessboard/chessboard.h"
+
+using namespace gv;
+
+/**************************************************************************************************************/
+// HELPERS
+
+static const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static long long perft(chessboard::Board& board, int depth)
+{
+    chessboard::MoveList mvs;
+    board.generateMoves(mvs);
+
+    // bulk count the last ply without making the moves
+    if (depth == 1)
+        return mvs.size;
+
+    long long nodes = 0;
+    for (auto mv : mvs)
+    {
+        board.makeMove(mv);
+        nodes += perft(board, depth - 1);
+        board.unmakeMove();
+    }
+    return nodes;
+}
+
+// copies raw values into a new bytes object and returns a memoryview of it cast to the given struct format
+// numpy.asarray or numpy.frombuffer wrap the result without copying
+static PyObject* makeArray(const void* data, std::size_t bytes, const char* format)
+{
+    PyObject* buf = PyBytes_FromStringAndSize((const char*)data, bytes);
+    if (buf == nullptr)
+        return nullptr;
+    PyObject* view = PyMemoryView_FromObject(buf);
+    Py_DECREF(buf);
+    if (view == nullptr)
+        return nullptr;
+    PyObject* cast = PyObject_CallMethod(view, "cast", "s", format);
+    Py_DECREF(view);
+    return cast;
+}
+
+static PyObject* playerToPy(chessboard::Player plr)
+{
+    if (plr == chessboard::PLAYER_NULL)
+        Py_RETURN_NONE;
+    return PyUnicode_FromString((plr == chessboard::WHITE) ? "w" : "b");
+}
+
+static PyObject* moveToPy(chessboard::PackedMove mv)
+{
+    char str[chessboard::UCI_BUFFER_SIZE];
+    chessboard::Board::toUCI(mv, str);
+    return PyUnicode_FromString(str);
+}
+
+/**************************************************************************************************************/
+// BOARD TYPE
+
+// the board is held by pointer as it is not a plain C struct
+struct PyBoard
+{
+    PyObject_HEAD
+    chessboard::Board* board;
+};
+
+static PyObject* Board_new(PyTypeObject* type, PyObject* args, PyObject* kwds)
+{
+    PyBoard* self = (PyBoard*)type->tp_alloc(type, 0);
+    if (self == nullptr)
+        return nullptr;
+    self->board = new chessboard::Board();
+    self->board->loadFEN(START_FEN);
+    return (PyObject*)self;
+}
+
+static void Board_dealloc(PyBoard* self)
+{
+    delete self->board;
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+// Board(fen=None), the starting position if no FEN is given
+static int Board_init(PyBoard* self, PyObject* args, PyObject* kwds)
+{
+    static const char* kwlist[] = { "fen", nullptr };
+    const char* fen = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|z", (char**)kwlist, &fen))
+        return -1;
+    if (self->board->loadFEN(fen ? fen : START_FEN) == false)
+    {
+        PyErr_Format(PyExc_ValueError, "invalid FEN: %s", fen);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject* Board_setup(PyBoard* self, PyObject* noargs)
+{
+    self->board->loadFEN(START_FEN);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Board_load_fen(PyBoard* self, PyObject* args)
+{
+    const char* fen;
+    if (!PyArg_ParseTuple(args, "s", &fen))
+        return nullptr;
+    if (self->board->loadFEN(fen) == false)
+        return PyErr_Format(PyExc_ValueError, "invalid FEN: %s", fen);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Board_fen(PyBoard* self, PyObject* noargs)
+{
+    return PyUnicode_FromString(self->board->toFEN().c_str());
+}
+
+static PyObject* Board_turn(PyBoard* self, PyObject* noargs)
+{
+    return playerToPy(self->board->getPlayerToMove());
+}
+
+static PyObject* Board_check(PyBoard* self, PyObject* noargs)
+{
+    return playerToPy(self->board->getCheck());
+}
+
+static PyObject* Board_status(PyBoard* self, PyObject* noargs)
+{
+    static const char* names[] = { "in_progress", "checkmate", "draw", "stalemate" };
+    return PyUnicode_FromString(names[self->board->getStatus()]);
+}
+
+static PyObject* Board_winner(PyBoard* self, PyObject* noargs)
+{
+    return playerToPy(self->board->getWinner());
+}
+
+// request_move((file, rank), (file, rank), promotion="q"), squares as in chess.py with (0, 0) = a1
+static PyObject* Board_request_move(PyBoard* self, PyObject* args)
+{
+    int sf, sr, ef, er;
+    const char* promotion = "q";
+    if (!PyArg_ParseTuple(args, "(ii)(ii)|s", &sf, &sr, &ef, &er, &promotion))
+        return nullptr;
+
+    chessboard::Piece piece;
+    switch (promotion[0])
+    {
+        case 'q': case 'Q': piece = chessboard::QUEEN;  break;
+        case 'r': case 'R': piece = chessboard::ROOK;   break;
+        case 'b': case 'B': piece = chessboard::BISHOP; break;
+        case 'n': case 'N': piece = chessboard::KNIGHT; break;
+        default: return PyErr_Format(PyExc_ValueError, "invalid promotion piece: %s", promotion);
+    }
+
+    chessboard::Move mv({sf, sr}, {ef, er});
+    return PyBool_FromLong(self->board->requestMove(mv, piece) == chessboard::SUCCESS);
+}
+
+// legal moves as UCI strings
+static PyObject* Board_legal_moves(PyBoard* self, PyObject* noargs)
+{
+    chessboard::MoveList mvs;
+    self->board->generateMoves(mvs);
+    PyObject* list = PyList_New(mvs.size);
+    if (list == nullptr)
+        return nullptr;
+    for (int i = 0; i < mvs.size; ++i)
+    {
+        PyObject* str = moveToPy(mvs[i]);
+        if (str == nullptr)
+        {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, i, str);
+    }
+    return list;
+}
+
+// legal moves as 16 bit packed moves, from square in bits 0-5, to square in bits 6-11 and flags in bits 12-15
+static PyObject* Board_move_array(PyBoard* self, PyObject* noargs)
+{
+    chessboard::MoveList mvs;
+    self->board->generateMoves(mvs);
+    return makeArray(mvs.moves, mvs.size*sizeof(chessboard::PackedMove), "H");
+}
+
+// parses a UCI move string or a packed move, raises ValueError unless it is legal
+static bool parseMove(chessboard::Board& board, PyObject* obj, chessboard::PackedMove& mv)
+{
+    if (PyUnicode_Check(obj))
+    {
+        Py_ssize_t size;
+        const char* str = PyUnicode_AsUTF8AndSize(obj, &size);
+        if (str == nullptr)
+            return false;
+        mv = board.fromUCI(std::string_view(str, size));
+    }
+    else
+    {
+        long val = PyLong_AsLong(obj);
+        if (val == -1 && PyErr_Occurred())
+            return false;
+        mv.data = std::uint16_t(val);
+        if (val < 0 || val > 0xFFFF || board.isValidMove(mv) == false)
+            mv = chessboard::PackedMove();
+    }
+
+    if (mv.isNull())
+    {
+        PyErr_Format(PyExc_ValueError, "illegal move: %R", obj);
+        return false;
+    }
+    return true;
+}
+
+static PyObject* Board_push(PyBoard* self, PyObject* obj)
+{
+    chessboard::PackedMove mv;
+    if (parseMove(*self->board, obj, mv) == false)
+        return nullptr;
+    self->board->makeMove(mv);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Board_pop(PyBoard* self, PyObject* noargs)
+{
+    int depth = self->board->getUndoDepth();
+    if (depth == 0)
+    {
+        PyErr_SetString(PyExc_IndexError, "no move to take back");
+        return nullptr;
+    }
+    chessboard::PackedMove mv = self->board->getUndoRecord(depth - 1).mv;
+    self->board->unmakeMove();
+    return moveToPy(mv);
+}
+
+static PyObject* Board_san(PyBoard* self, PyObject* obj)
+{
+    chessboard::PackedMove mv;
+    if (parseMove(*self->board, obj, mv) == false)
+        return nullptr;
+    char str[chessboard::SAN_BUFFER_SIZE];
+    self->board->toSAN(mv, str);
+    return PyUnicode_FromString(str);
+}
+
+static PyObject* Board_uci(PyBoard* self, PyObject* args)
+{
+    const char* san;
+    if (!PyArg_ParseTuple(args, "s", &san))
+        return nullptr;
+    chessboard::PackedMove mv = self->board->fromSAN(san);
+    if (mv.isNull())
+        return PyErr_Format(PyExc_ValueError, "illegal move: %s", san);
+    return moveToPy(mv);
+}
+
+// the GIL is released while counting so other Python threads keep running, the count runs on a copy of the board
+// so they may use this board meanwhile
+static PyObject* Board_perft(PyBoard* self, PyObject* args)
+{
+    int depth;
+    if (!PyArg_ParseTuple(args, "i", &depth))
+        return nullptr;
+    if (depth < 1)
+        return PyLong_FromLong(1);
+
+    chessboard::Board board = *self->board;
+    long long nodes;
+    Py_BEGIN_ALLOW_THREADS
+    nodes = perft(board, depth);
+    Py_END_ALLOW_THREADS
+    return PyLong_FromLongLong(nodes);
+}
+
+static PyMethodDef Board_methods[] = {
+    { "setup", (PyCFunction)Board_setup, METH_NOARGS, "Resets to the starting position." },
+    { "load_fen", (PyCFunction)Board_load_fen, METH_VARARGS, "Sets up the position from a FEN string, raises ValueError if it is malformed." },
+    { "fen", (PyCFunction)Board_fen, METH_NOARGS, "Returns the position as a FEN string." },
+    { "turn", (PyCFunction)Board_turn, METH_NOARGS, "Returns the player to move, 'w' or 'b'." },
+    { "check", (PyCFunction)Board_check, METH_NOARGS, "Returns the player in check, 'w', 'b' or None." },
+    { "status", (PyCFunction)Board_status, METH_NOARGS, "Returns 'in_progress', 'checkmate', 'draw' or 'stalemate'." },
+    { "winner", (PyCFunction)Board_winner, METH_NOARGS, "Returns the winner, 'w', 'b' or None." },
+    { "request_move", (PyCFunction)Board_request_move, METH_VARARGS, "request_move((file, rank), (file, rank), promotion='q'), makes the move if it is legal and returns whether it was." },
+    { "legal_moves", (PyCFunction)Board_legal_moves, METH_NOARGS, "Returns the legal moves as UCI strings." },
+    { "move_array", (PyCFunction)Board_move_array, METH_NOARGS, "Returns the legal moves as a uint16 memoryview of packed moves." },
+    { "push", (PyCFunction)Board_push, METH_O, "Makes a move given as a UCI string or packed move, raises ValueError if it is illegal." },
+    { "pop", (PyCFunction)Board_pop, METH_NOARGS, "Takes back the last pushed or requested move and returns it as a UCI string." },
+    { "san", (PyCFunction)Board_san, METH_O, "Returns a legal move given as a UCI string or packed move in standard algebraic notation." },
+    { "uci", (PyCFunction)Board_uci, METH_VARARGS, "Returns a legal move given in standard algebraic notation as a UCI string." },
+    { "perft", (PyCFunction)Board_perft, METH_VARARGS, "Counts the leaf nodes of the move tree to the given depth." },
+    { nullptr }
+};
+
+static PyTypeObject BoardType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+};
+
+/**************************************************************************************************************/
+// MODULE
+
+// moves_batch(fens) -> (offsets, moves), the legal moves of many positions in one call
+// the moves of position i are moves[offsets[i]:offsets[i + 1]], offsets are uint32 and moves uint16 packed moves
+static PyObject* moves_batch(PyObject* module, PyObject* arg)
+{
+    // a tuple snapshot, the caller's list may be changed by other threads while the GIL is released
+    PyObject* seq = PySequence_Tuple(arg);
+    if (seq == nullptr)
+        return nullptr;
+
+    Py_ssize_t num = PyTuple_GET_SIZE(seq);
+    std::vector<std::string_view> fens(num);
+    for (Py_ssize_t i = 0; i < num; ++i)
+    {
+        Py_ssize_t size;
+        const char* str = PyUnicode_AsUTF8AndSize(PyTuple_GET_ITEM(seq, i), &size);
+        if (str == nullptr)
+        {
+            Py_DECREF(seq);
+            return nullptr;
+        }
+        fens[i] = std::string_view(str, size); // valid while the tuple holds the strings, which can't change
+    }
+
+    std::vector<std::uint32_t> offsets(num + 1, 0);
+    std::vector<chessboard::PackedMove> moves;
+    Py_ssize_t bad = -1;
+    Py_BEGIN_ALLOW_THREADS
+    chessboard::Board board;
+    chessboard::MoveList mvs;
+    moves.reserve(num*40);
+    for (Py_ssize_t i = 0; i < num; ++i)
+    {
+        if (board.loadFEN(fens[i]) == false)
+        {
+            bad = i;
+            break;
+        }
+        board.generateMoves(mvs);
+        moves.insert(moves.end(), mvs.begin(), mvs.end());
+        offsets[i + 1] = std::uint32_t(moves.size());
+        mvs.clear();
+    }
+    Py_END_ALLOW_THREADS
+
+    if (bad >= 0)
+    {
+        PyErr_Format(PyExc_ValueError, "invalid FEN at index %zd: %R", bad, PyTuple_GET_ITEM(seq, bad));
+        Py_DECREF(seq);
+        return nullptr;
+    }
+    Py_DECREF(seq);
+
+    PyObject* offsetArray = makeArray(offsets.data(), offsets.size()*sizeof(std::uint32_t), "I");
+    PyObject* moveArray = makeArray(moves.data(), moves.size()*sizeof(chessboard::PackedMove), "H");
+    if (offsetArray == nullptr || moveArray == nullptr)
+    {
+        Py_XDECREF(offsetArray);
+        Py_XDECREF(moveArray);
+        return nullptr;
+    }
+    return Py_BuildValue("(NN)", offsetArray, moveArray);
+}
+
+static PyMethodDef module_methods[] = {
+    { "moves_batch", moves_batch, METH_O, "moves_batch(fens) -> (offsets, moves), the legal moves of many positions as uint32 offsets and uint16 packed moves." },
+    { nullptr }
+};
+
+static PyModuleDef gvchess_module = {
+    PyModuleDef_HEAD_INIT, "gvchess", "Bindings to the C++ chessboard.", -1, module_methods
+};
+
+PyMODINIT_FUNC PyInit_gvchess()
+{
+    BoardType.tp_name = "gvchess.Board";
+    BoardType.tp_doc = "Board(fen=None), a chess position, the starting position if no FEN is given.";
+    BoardType.tp_basicsize = sizeof(PyBoard);
+    BoardType.tp_flags = Py_TPFLAGS_DEFAULT;
+    BoardType.tp_new = Board_new;
+    BoardType.tp_init = (initproc)Board_init;
+    BoardType.tp_dealloc = (destructor)Board_dealloc;
+    BoardType.tp_methods = Board_methods;
+    if (PyType_Ready(&BoardType) < 0)
+        return nullptr;
+
+    PyObject* module = PyModule_Create(&gvchess_module);
+    if (module == nullptr)
+        return nullptr;
+    Py_INCREF(&BoardType);
+    if (PyModule_AddObject(module, "Board", (PyObject*)&BoardType) < 0)
+    {
+        Py_DECREF(&BoardType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
@@ -0,0 +1,119 @@
+#include "../../pgn/pgn.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace gv;
+
+/**************************************************************************************************************/
+// MAIN
+
+static void printUsage()
+{
+    std::cout << "usage: replay [-threads n] [-fen] [-quiet] file.pgn ..." << std::endl;
+    std::cout << "replays every game of the PGN files on n threads (default all cores) and prints one line per game," << std::endl;
+    std::cout << "-fen also prints the FEN of every position, -quiet prints only errors and the totals" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+    bool printFEN = false;
+    bool quiet = false;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-threads" && i + 1 < argc)
+        {
+            numThreads = std::max(std::atoi(argv[++i]), 1);
+        }
+        else if (arg == "-fen")
+        {
+            printFEN = true;
+        }
+        else if (arg == "-quiet")
+        {
+            quiet = true;
+        }
+        else if (arg[0] != '-')
+        {
+            files.push_back(arg);
+        }
+        else
+        {
+            printUsage();
+            return (arg == "-h" || arg == "-help") ? 0 : 1;
+        }
+    }
+    if (files.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    long long totalGames = 0;
+    long long totalErrors = 0;
+    long long totalPlies = 0;
+    double totalBytes = 0.0;
+    auto start = std::chrono::steady_clock::now();
+
+    std::mutex outputMutex;
+    for (auto& path : files)
+    {
+        pgn::MappedFile file;
+        if (file.open(path) == false)
+        {
+            std::cerr << "could not open " << path << std::endl;
+            return 1;
+        }
+        std::vector<std::string_view> games = pgn::splitGames(file.view());
+
+        std::atomic<long long> errors(0);
+        std::atomic<long long> plies(0);
+        pgn::replayGames(games, numThreads, [&](std::size_t index, const pgn::Game& game, chessboard::Board& board)
+        {
+            plies += game.moves.size();
+            if (!game.ok)
+                errors++;
+            if (quiet && game.ok)
+                return;
+
+            // build the game's output first so games printed from different threads don't interleave
+            std::ostringstream os;
+            os << path << " game " << index + 1 << " " << (game.result.empty() ? "?" : game.result) << " plies " << game.moves.size();
+            if (!game.ok)
+                os << " error " << game.error;
+            os << "\n";
+            if (printFEN)
+            {
+                board.loadFEN(game.startFEN);
+                os << board.toFEN() << "\n";
+                for (auto mv : game.moves)
+                {
+                    board.makeMove(mv);
+                    os << board.toFEN() << "\n";
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << os.str();
+        });
+
+        totalGames += games.size();
+        totalErrors += errors;
+        totalPlies += plies;
+        totalBytes += file.view().size();
+    }
+
+    double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "games " << totalGames << "  errors " << totalErrors << "  plies " << totalPlies << "  time " << time << " s"
+        << "  games/sec " << (long long)(totalGames / std::max(time, 1e-9))
+        << "  plies/sec " << (long long)(totalPlies / std::max(time, 1e-9))
+        << "  MB/sec " << totalBytes / (1 << 20) / std::max(time, 1e-9) << std::endl;
+    return totalErrors > 0;
+}
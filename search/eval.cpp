@@ -0,0 +1,88 @@
+#include "eval.h"
+#include "pawns.h"
+
+namespace gv
+{
+namespace search
+{
+
+/**************************************************************************************/
+// EVALUATOR
+
+// [PUBLIC]
+Evaluator::Evaluator()
+{
+    terms.push_back(pawnStructureTerm);
+}
+
+// [PUBLIC]
+void Evaluator::addTerm(EvalTerm term)
+{
+    terms.push_back(term);
+}
+
+// [PUBLIC] removes every term including the default pawn structure term
+void Evaluator::clearTerms()
+{
+    terms.clear();
+}
+
+// [PUBLIC]
+void Evaluator::setNetwork(std::shared_ptr<const Network> net)
+{
+    nnue.setNetwork(net);
+}
+
+// [PUBLIC] blends the midgame and endgame scores by the phase, full material scores as midgame
+int Evaluator::evaluate(chessboard::Board& board)
+{
+    if (nnue.hasNetwork())
+        return nnue.evaluate(board);
+
+    chessboard::TaperedScore score = board.getPSQTScore();
+    for (auto term : terms)
+    {
+        score += term(board);
+    }
+
+    int phase = std::min(board.getPhase(), chessboard::MAX_PHASE);
+    int blended = (score.mg*phase + score.eg*(chessboard::MAX_PHASE - phase)) / chessboard::MAX_PHASE;
+    return (board.getPlayerToMove() == chessboard::WHITE) ? blended : -blended;
+}
+
+/**************************************************************************************/
+// TERMS
+
+// weights per square
+static const chessboard::TaperedScore MOBILITY_WEIGHT = { 2, 3 };
+static const chessboard::TaperedScore KING_ZONE_ATTACK_WEIGHT = { -8, -2 };
+
+// [PUBLIC]
+chessboard::TaperedScore mobilityTerm(chessboard::Board& board)
+{
+    int mobility[2];
+    for (int p = chessboard::WHITE; p <= chessboard::BLACK; ++p)
+    {
+        chessboard::Player plr = (chessboard::Player)p;
+        mobility[plr] = chessboard::popCount(board.getSqrCoverage(plr) & ~board.getOccupancyBB(plr));
+    }
+    return MOBILITY_WEIGHT * (mobility[chessboard::WHITE] - mobility[chessboard::BLACK]);
+}
+
+// [PUBLIC]
+chessboard::TaperedScore kingSafetyTerm(chessboard::Board& board)
+{
+    int attacked[2];
+    for (int p = chessboard::WHITE; p <= chessboard::BLACK; ++p)
+    {
+        chessboard::Player plr = (chessboard::Player)p;
+        int kingInd = chessboard::lsb(board.getPieceBB(plr, chessboard::KING));
+        chessboard::Bitboard zone = chessboard::kingAttacks(kingInd) | chessboard::sqrBB(kingInd);
+        attacked[plr] = chessboard::popCount(zone & board.getSqrCoverage(chessboard::opponent(plr)));
+    }
+    return KING_ZONE_ATTACK_WEIGHT * (attacked[chessboard::WHITE] - attacked[chessboard::BLACK]);
+}
+
+} // namespace search
+
+} // namespace gv
@@ -0,0 +1,42 @@
+/* Static evaluation */
+#pragma once
+
+#include "../chessboard/chessboard.h"
+#include "nnue.h"
+
+namespace gv
+{
+
+namespace search
+{
+
+// an extra evaluation term, returns its score from white's point of view
+typedef chessboard::TaperedScore (*EvalTerm)(chessboard::Board& board);
+
+// tapered evaluation, the board's incrementally updated material and piece-square score plus any added terms
+// starts with the pawn structure term, which is a pawn table hit for most positions
+// with a network set the terms are put aside and positions are scored by the network instead
+class Evaluator
+{
+
+private:
+    std::vector<EvalTerm> terms;
+    NnueEvaluator nnue;
+
+public:
+    Evaluator();
+
+    void addTerm(EvalTerm term);
+    void clearTerms();
+    void setNetwork(std::shared_ptr<const Network> net); // null goes back to the handcrafted evaluation
+
+    int evaluate(chessboard::Board& board); // centipawns from the point of view of the player to move
+};
+
+// terms that can be added to an evaluator, both reuse the square coverage the board keeps for move generation
+chessboard::TaperedScore mobilityTerm(chessboard::Board& board); // covered squares not holding own pieces
+chessboard::TaperedScore kingSafetyTerm(chessboard::Board& board); // enemy coverage of the squares around each king
+
+} // namespace search
+
+} // namespace gv
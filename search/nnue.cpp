@@ -0,0 +1,372 @@
+#include "nnue.h"
+#include <cstdlib>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace gv
+{
+namespace search
+{
+
+/**************************************************************************************/
+// KERNELS
+
+// accumulator rows are NNUE_L1 int16 lanes, AVX2 handles 16 lanes at a time, SSE2 8 and the fallback 1
+// the 128 bit path only needs SSE2, so it is used by every x86-64 build without further flags
+
+// acc += row
+static void addRow(std::int16_t* acc, const std::int16_t* row)
+{
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_L1; i += 16)
+    {
+        __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+        __m256i r = _mm256_load_si256((const __m256i*)(row + i));
+        _mm256_store_si256((__m256i*)(acc + i), _mm256_add_epi16(a, r));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < NNUE_L1; i += 8)
+    {
+        __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+        __m128i r = _mm_load_si128((const __m128i*)(row + i));
+        _mm_store_si128((__m128i*)(acc + i), _mm_add_epi16(a, r));
+    }
+#else
+    for (int i = 0; i < NNUE_L1; ++i)
+        acc[i] += row[i];
+#endif
+}
+
+// acc -= row
+static void subRow(std::int16_t* acc, const std::int16_t* row)
+{
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_L1; i += 16)
+    {
+        __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+        __m256i r = _mm256_load_si256((const __m256i*)(row + i));
+        _mm256_store_si256((__m256i*)(acc + i), _mm256_sub_epi16(a, r));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < NNUE_L1; i += 8)
+    {
+        __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+        __m128i r = _mm_load_si128((const __m128i*)(row + i));
+        _mm_store_si128((__m128i*)(acc + i), _mm_sub_epi16(a, r));
+    }
+#else
+    for (int i = 0; i < NNUE_L1; ++i)
+        acc[i] -= row[i];
+#endif
+}
+
+// sum of the clipped accumulator times the output weights
+static std::int32_t clippedDot(const std::int16_t* acc, const std::int16_t* weights)
+{
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i clip = _mm256_set1_epi16(NNUE_CLIP);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < NNUE_L1; i += 16)
+    {
+        __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+        a = _mm256_min_epi16(_mm256_max_epi16(a, zero), clip);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, _mm256_load_si256((const __m256i*)(weights + i))));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i clip = _mm_set1_epi16(NNUE_CLIP);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < NNUE_L1; i += 8)
+    {
+        __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+        a = _mm_min_epi16(_mm_max_epi16(a, zero), clip);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(a, _mm_load_si128((const __m128i*)(weights + i))));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    std::int32_t sum = 0;
+    for (int i = 0; i < NNUE_L1; ++i)
+        sum += std::min(std::max(int(acc[i]), 0), NNUE_CLIP) * weights[i];
+    return sum;
+#endif
+}
+
+// input index of a piece seen from one side, squares are mirrored for black so both sides see their pieces from rank 1
+static int featureIndex(chessboard::Player persp, int kingInd, chessboard::Piece type, chessboard::Player owner, int ind)
+{
+    int flip = (persp == chessboard::WHITE) ? 0 : 56;
+    return (kingInd ^ flip)*640 + (type*2 + (owner != persp))*64 + (ind ^ flip);
+}
+
+/**************************************************************************************/
+// NETWORK
+
+static const char NETWORK_MAGIC[4] = { 'G', 'V', 'N', 'N' };
+static const std::uint32_t NETWORK_VERSION = 1;
+
+// [PUBLIC]
+bool Network::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    char magic[4];
+    std::uint32_t version, inputs, l1;
+    std::int32_t scale;
+    file.read(magic, sizeof(magic));
+    file.read((char*)&version, sizeof(version));
+    file.read((char*)&inputs, sizeof(inputs));
+    file.read((char*)&l1, sizeof(l1));
+    file.read((char*)&scale, sizeof(scale));
+    if (!file || std::memcmp(magic, NETWORK_MAGIC, sizeof(magic)) != 0 || version != NETWORK_VERSION
+        || inputs != NNUE_INPUTS || l1 != NNUE_L1 || scale <= 0)
+        return false;
+
+    // read into a temporary so a truncated file leaves the network unchanged
+    std::unique_ptr<Network> net(new Network());
+    net->outputScale = scale;
+    file.read((char*)net->ftBias, sizeof(ftBias));
+    file.read((char*)net->ftWeights, sizeof(ftWeights));
+    file.read((char*)&net->outBias, sizeof(outBias));
+    file.read((char*)net->outWeights, sizeof(outWeights));
+    if (!file || file.peek() != std::ifstream::traits_type::eof())
+        return false;
+
+    *this = *net;
+    return true;
+}
+
+// [PUBLIC]
+bool Network::save(const std::string& path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    std::uint32_t inputs = NNUE_INPUTS;
+    std::uint32_t l1 = NNUE_L1;
+    file.write(NETWORK_MAGIC, sizeof(NETWORK_MAGIC));
+    file.write((const char*)&NETWORK_VERSION, sizeof(NETWORK_VERSION));
+    file.write((const char*)&inputs, sizeof(inputs));
+    file.write((const char*)&l1, sizeof(l1));
+    file.write((const char*)&outputScale, sizeof(outputScale));
+    file.write((const char*)ftBias, sizeof(ftBias));
+    file.write((const char*)ftWeights, sizeof(ftWeights));
+    file.write((const char*)&outBias, sizeof(outBias));
+    file.write((const char*)outWeights, sizeof(outWeights));
+    return bool(file);
+}
+
+// [PUBLIC] a network that counts material, for testing the evaluation path without a trained network
+// lanes 0-4 count the side's own pawns, rooks, knights, bishops and queens and lanes 5-9 the enemy's, which the
+// output layer weighs by piece value; the remaining lanes carry fixed pseudo random weights with no say in the output
+// so every lane of the accumulators is still exercised by the incremental updates
+std::unique_ptr<Network> Network::makeTestNetwork()
+{
+    static const std::int16_t values[5] = { 100, 500, 320, 330, 900 }; // in chessboard::Piece order
+
+    std::unique_ptr<Network> net(new Network());
+    std::memset(net.get(), 0, sizeof(Network));
+    net->outputScale = 1;
+
+    std::uint32_t state = 12345;
+    for (int k = 0; k < 64; ++k)
+    {
+        for (int t = 0; t < 10; ++t) // piece type*2 + 1 if the piece is the enemy's
+        {
+            for (int i = 0; i < 64; ++i)
+            {
+                std::int16_t* row = net->ftWeights[k*640 + t*64 + i];
+                row[(t % 2)*5 + t / 2] = 1;
+                for (int lane = 10; lane < NNUE_L1; ++lane)
+                {
+                    state = state*1664525u + 1013904223u;
+                    row[lane] = std::int16_t(int(state >> 29) - 4); // -4..3
+                }
+            }
+        }
+    }
+    for (int t = 0; t < 5; ++t)
+    {
+        net->outWeights[t] = values[t];
+        net->outWeights[5 + t] = -values[t];
+    }
+    return net;
+}
+
+/**************************************************************************************/
+// NNUE EVALUATOR
+
+// lines longer than this are rebuilt from scratch rather than replayed
+static const int MAX_REPLAY = 16;
+
+// [PUBLIC] the network is shared, read only, between evaluators
+void NnueEvaluator::setNetwork(std::shared_ptr<const Network> net)
+{
+    network = net;
+    stack.clear();
+}
+
+// [PUBLIC]
+bool NnueEvaluator::hasNetwork()
+{
+    return network != nullptr;
+}
+
+// [PUBLIC]
+int NnueEvaluator::evaluate(chessboard::Board& board)
+{
+    update(board, chessboard::WHITE);
+    update(board, chessboard::BLACK);
+#ifdef CHESSBOARD_DEBUG
+    checkAccumulators(board);
+#endif
+
+    const Accumulator& acc = stack[board.getUndoDepth()];
+    chessboard::Player us = board.getPlayerToMove();
+    std::int32_t out = network->outBias + clippedDot(acc.values[us], network->outWeights)
+        + clippedDot(acc.values[chessboard::opponent(us)], network->outWeights + NNUE_L1);
+    return out / network->outputScale;
+}
+
+// [PRIVATE] brings one side's accumulator of the board's position up to date
+void NnueEvaluator::update(chessboard::Board& board, chessboard::Player persp)
+{
+    int depth = board.getUndoDepth();
+    if ((int)stack.size() <= depth)
+        stack.resize(depth + 1);
+
+    chessboard::Player toMove = board.getPlayerToMove();
+    auto keyAt = [&](int k) { return (k < depth) ? board.getUndoRecord(k).hashKey : board.hash(); };
+    auto moverAt = [&](int k) { return ((depth - k) % 2 == 1) ? chessboard::opponent(toMove) : toMove; };
+    auto claim = [&](int k) -> Accumulator&
+    {
+        Accumulator& acc = stack[k];
+        if (acc.key != keyAt(k))
+        {
+            acc.key = keyAt(k);
+            acc.computed[chessboard::WHITE] = false;
+            acc.computed[chessboard::BLACK] = false;
+        }
+        acc.computed[persp] = true;
+        return acc;
+    };
+    auto kingMoveAt = [&](int k) { return board.getUndoRecord(k).moved == chessboard::KING && moverAt(k) == persp; };
+
+    // this side's king is where it is now for every position the accumulator is carried through
+    int kingInd = chessboard::lsb(board.getPieceBB(persp, chessboard::KING));
+
+    // walk back to the nearest accumulator of the line already computed for this side
+    // a move of this side's king changes every one of its inputs, so nothing before it can be reused
+    int k = depth;
+    while (!(stack[k].key == keyAt(k) && stack[k].computed[persp]))
+    {
+        if (k == 0 || depth - k >= MAX_REPLAY || kingMoveAt(k - 1))
+        {
+            refresh(board, persp, claim(depth).values[persp]);
+
+            // take the last move back as well so the position's siblings are one update away
+            if (depth > 0 && !kingMoveAt(depth - 1))
+            {
+                std::int16_t* parent = claim(depth - 1).values[persp];
+                std::memcpy(parent, stack[depth].values[persp], sizeof(stack[depth].values[persp]));
+                applyMove(board.getUndoRecord(depth - 1), moverAt(depth - 1), persp, kingInd, parent, true);
+            }
+            return;
+        }
+        k--;
+    }
+
+    // replay the piece changes of each move
+    for (; k < depth; ++k)
+    {
+        std::int16_t* acc = claim(k + 1).values[persp];
+        std::memcpy(acc, stack[k].values[persp], sizeof(stack[k].values[persp]));
+        applyMove(board.getUndoRecord(k), moverAt(k), persp, kingInd, acc, false);
+    }
+}
+
+// [PRIVATE] adds the piece changes of a move to one side's accumulator, or removes them to take the move back
+// the side's own king must not be the piece moved
+void NnueEvaluator::applyMove(const chessboard::UndoRecord& rec, chessboard::Player mover, chessboard::Player persp, int kingInd, std::int16_t* acc, bool takeBack)
+{
+    int start = rec.mv.start();
+    int end = rec.mv.end();
+    int flags = rec.mv.flags();
+
+    auto add = [&](chessboard::Piece type, chessboard::Player owner, int ind)
+    {
+        const std::int16_t* row = network->ftWeights[featureIndex(persp, kingInd, type, owner, ind)];
+        takeBack ? subRow(acc, row) : addRow(acc, row);
+    };
+    auto sub = [&](chessboard::Piece type, chessboard::Player owner, int ind)
+    {
+        const std::int16_t* row = network->ftWeights[featureIndex(persp, kingInd, type, owner, ind)];
+        takeBack ? addRow(acc, row) : subRow(acc, row);
+    };
+
+    if (rec.moved != chessboard::KING)
+    {
+        sub(rec.moved, mover, start);
+        add(rec.mv.isPromotion() ? rec.mv.promotion() : rec.moved, mover, end);
+    }
+    if (rec.captured != chessboard::PIECE_NULL)
+    {
+        int capturedInd = (flags == chessboard::ENPSSNT) ? (start & ~7) | (end & 7) : end; // beside the start square for en passant
+        sub(rec.captured, chessboard::opponent(mover), capturedInd);
+    }
+    if (flags == chessboard::CASTLE_KS || flags == chessboard::CASTLE_QS)
+    {
+        int rankInd = start & ~7;
+        sub(chessboard::ROOK, mover, rankInd + ((flags == chessboard::CASTLE_KS) ? 7 : 0));
+        add(chessboard::ROOK, mover, rankInd + ((flags == chessboard::CASTLE_KS) ? 5 : 3));
+    }
+}
+
+// [PRIVATE] computes one side's accumulator from scratch
+void NnueEvaluator::refresh(chessboard::Board& board, chessboard::Player persp, std::int16_t* acc)
+{
+    std::memcpy(acc, network->ftBias, sizeof(network->ftBias));
+    int kingInd = chessboard::lsb(board.getPieceBB(persp, chessboard::KING));
+    for (int p = chessboard::WHITE; p <= chessboard::BLACK; ++p)
+    {
+        for (int t = chessboard::PAWN; t < chessboard::KING; ++t)
+        {
+            chessboard::Bitboard pieces = board.getPieceBB((chessboard::Player)p, (chessboard::Piece)t);
+            while (pieces)
+            {
+                int ind = chessboard::popLsb(pieces);
+                addRow(acc, network->ftWeights[featureIndex(persp, kingInd, (chessboard::Piece)t, (chessboard::Player)p, ind)]);
+            }
+        }
+    }
+}
+
+// [PRIVATE] debug check that the incrementally updated accumulators match a rebuild from scratch, aborts if not
+void NnueEvaluator::checkAccumulators(chessboard::Board& board)
+{
+    alignas(32) std::int16_t expected[NNUE_L1];
+    for (int p = chessboard::WHITE; p <= chessboard::BLACK; ++p)
+    {
+        refresh(board, (chessboard::Player)p, expected);
+        if (std::memcmp(expected, stack[board.getUndoDepth()].values[p], sizeof(expected)) != 0)
+        {
+            std::cerr << "Accumulator mismatch for " << (chessboard::Player)p << " in " << board.toFEN() << std::endl;
+            std::abort();
+        }
+    }
+}
+
+} // namespace search
+
+} // namespace gv
@@ -0,0 +1,71 @@
+/* Efficiently updatable neural network evaluation */
+#pragma once
+
+#include "../chessboard/chessboard.h"
+#include <memory>
+
+namespace gv
+{
+
+namespace search
+{
+
+// HalfKP inputs, for each side the position of its own king crossed with every other piece and square
+// the network is HalfKP -> 2 x NNUE_L1 accumulators -> clipped ReLU -> 1 output
+const int NNUE_INPUTS = 64*10*64; // [king square][piece type and colour][square]
+const int NNUE_L1 = 64;
+const int NNUE_CLIP = 127; // accumulator values are clipped to 0..NNUE_CLIP before the output layer
+
+// quantised network weights
+// file format, little endian: "GVNN", uint32 version, uint32 inputs, uint32 l1, int32 output scale,
+// int16 ftBias[l1], int16 ftWeights[inputs][l1], int32 outBias, int16 outWeights[2*l1]
+struct Network
+{
+    alignas(32) std::int16_t ftBias[NNUE_L1];
+    alignas(32) std::int16_t ftWeights[NNUE_INPUTS][NNUE_L1];
+    alignas(32) std::int16_t outWeights[2*NNUE_L1]; // side to move's accumulator first
+    std::int32_t outBias;
+    std::int32_t outputScale; // the output is divided by this to give centipawns
+
+    bool load(const std::string& path); // false if the file can't be read or its layout doesn't match this build
+    bool save(const std::string& path);
+
+    static std::unique_ptr<Network> makeTestNetwork();
+};
+
+// keeps the accumulators of a line of play, following the piece changes of the board's undo records
+// accumulators are brought up to date lazily when a position is evaluated, from the nearest position of the line
+// already computed, and are only rebuilt from scratch when a side's king moves or the line can't be followed
+// a rebuild also fills in the previous position of the line so its other moves are a single update away
+class NnueEvaluator
+{
+
+private:
+    struct Accumulator
+    {
+        alignas(32) std::int16_t values[2][NNUE_L1]; // [perspective]
+        std::uint64_t key; // hash of the position the accumulator belongs to
+        bool computed[2];
+    };
+
+    std::shared_ptr<const Network> network;
+    std::vector<Accumulator> stack; // indexed by the board's undo depth
+
+public:
+    NnueEvaluator() {}
+
+    void setNetwork(std::shared_ptr<const Network> net);
+    bool hasNetwork();
+
+    int evaluate(chessboard::Board& board); // centipawns from the point of view of the player to move
+
+private:
+    void update(chessboard::Board& board, chessboard::Player persp);
+    void applyMove(const chessboard::UndoRecord& rec, chessboard::Player mover, chessboard::Player persp, int kingInd, std::int16_t* acc, bool takeBack);
+    void refresh(chessboard::Board& board, chessboard::Player persp, std::int16_t* acc);
+    void checkAccumulators(chessboard::Board& board);
+};
+
+} // namespace search
+
+} // namespace gv
@@ -0,0 +1,187 @@
+#include "pawns.h"
+
+namespace gv
+{
+namespace search
+{
+
+/**************************************************************************************/
+// PAWN MASKS
+
+// pawn structure masks, built at compile time
+struct PawnMasks
+{
+    chessboard::Bitboard file[8];
+    chessboard::Bitboard adjacentFiles[8];
+    chessboard::Bitboard passed[2][64]; // [player][square], squares ahead on the pawn's own and adjacent files
+    chessboard::Bitboard support[2][64]; // [player][square], squares on adjacent files level with or behind the pawn
+
+    constexpr PawnMasks() : file(), adjacentFiles(), passed(), support()
+    {
+        for (int f = 0; f < 8; ++f)
+        {
+            for (int r = 0; r < 8; ++r)
+                file[f] |= chessboard::Bitboard(1) << (r*8 + f);
+        }
+        for (int f = 0; f < 8; ++f)
+            adjacentFiles[f] = ((f > 0) ? file[f - 1] : 0) | ((f < 7) ? file[f + 1] : 0);
+
+        for (int i = 0; i < 64; ++i)
+        {
+            int f = i % 8;
+            int r = i / 8;
+            for (int rr = 0; rr < 8; ++rr)
+            {
+                chessboard::Bitboard rank = chessboard::Bitboard(0xFF) << (rr*8);
+                if (rr > r)
+                    passed[chessboard::WHITE][i] |= rank & (file[f] | adjacentFiles[f]);
+                if (rr < r)
+                    passed[chessboard::BLACK][i] |= rank & (file[f] | adjacentFiles[f]);
+                if (rr <= r)
+                    support[chessboard::WHITE][i] |= rank & adjacentFiles[f];
+                if (rr >= r)
+                    support[chessboard::BLACK][i] |= rank & adjacentFiles[f];
+            }
+        }
+    }
+};
+
+static constexpr PawnMasks pawnMasks;
+
+/**************************************************************************************/
+// PAWN EVALUATION
+
+static const chessboard::TaperedScore DOUBLED_PAWN = { -10, -20 }; // per extra pawn on a file
+static const chessboard::TaperedScore ISOLATED_PAWN = { -10, -15 };
+static const chessboard::TaperedScore BACKWARD_PAWN = { -8, -10 };
+static const chessboard::TaperedScore PASSED_PAWN[8] = { // by rank counted from the pawn's own side
+    { 0, 0 }, { 5, 10 }, { 10, 15 }, { 15, 25 }, { 30, 45 }, { 50, 75 }, { 80, 120 }, { 0, 0 }
+};
+
+// [PUBLIC]
+chessboard::TaperedScore evaluatePawns(chessboard::Board& board)
+{
+    chessboard::TaperedScore score[2] = { { 0, 0 }, { 0, 0 } };
+    for (int p = chessboard::WHITE; p <= chessboard::BLACK; ++p)
+    {
+        chessboard::Player plr = (chessboard::Player)p;
+        chessboard::Bitboard own = board.getPieceBB(plr, chessboard::PAWN);
+        chessboard::Bitboard enemy = board.getPieceBB(chessboard::opponent(plr), chessboard::PAWN);
+
+        for (int f = 0; f < 8; ++f)
+        {
+            int onFile = chessboard::popCount(own & pawnMasks.file[f]);
+            if (onFile > 1)
+                score[plr] += DOUBLED_PAWN * (onFile - 1);
+        }
+
+        chessboard::Bitboard pawns = own;
+        while (pawns)
+        {
+            int i = chessboard::popLsb(pawns);
+            int f = i % 8;
+            int relRank = (plr == chessboard::WHITE) ? i / 8 : 7 - i / 8;
+
+            if ((own & pawnMasks.adjacentFiles[f]) == 0)
+            {
+                score[plr] += ISOLATED_PAWN;
+            }
+            else if ((own & pawnMasks.support[plr][i]) == 0)
+            {
+                // no neighbour can come up to defend it and an enemy pawn guards the square in front
+                int stop = (plr == chessboard::WHITE) ? i + 8 : i - 8;
+                if (chessboard::pawnAttacks(plr, stop) & enemy)
+                    score[plr] += BACKWARD_PAWN;
+            }
+
+            if ((enemy & pawnMasks.passed[plr][i]) == 0)
+                score[plr] += PASSED_PAWN[relRank];
+        }
+    }
+    return score[chessboard::WHITE] - score[chessboard::BLACK];
+}
+
+// [PUBLIC]
+chessboard::TaperedScore pawnStructureTerm(chessboard::Board& board)
+{
+    return PawnTable::threadTable().probe(board);
+}
+
+/**************************************************************************************/
+// PAWN TABLE
+
+// [PUBLIC] sized to the largest power of two number of entries that fits
+PawnTable::PawnTable(std::size_t kb)
+{
+    std::uint64_t bytes = std::uint64_t(std::max<std::size_t>(kb, 1)) << 10;
+    numEntries = 1;
+    while (numEntries*2*sizeof(Entry) <= bytes)
+    {
+        numEntries *= 2;
+    }
+    entries.reset(new Entry[numEntries]);
+    clear();
+}
+
+// [PUBLIC] empties the table and resets the statistics
+void PawnTable::clear()
+{
+    // a zero key with a zero score is correct for the position without pawns, so it doubles as the empty entry
+    for (std::uint64_t i = 0; i < numEntries; ++i)
+    {
+        entries[i].key = 0;
+        entries[i].score = { 0, 0 };
+    }
+    probes = 0;
+    hits = 0;
+}
+
+// [PUBLIC] returns the pawn structure score of the board, always replacing the entry on a miss
+chessboard::TaperedScore PawnTable::probe(chessboard::Board& board)
+{
+    std::uint64_t key = board.pawnHash();
+    Entry& entry = entries[key & (numEntries - 1)];
+    probes++;
+    if (entry.key == key)
+    {
+        hits++;
+        return entry.score;
+    }
+
+    entry.key = key;
+    entry.score = evaluatePawns(board);
+    return entry.score;
+}
+
+// [PUBLIC]
+std::uint64_t PawnTable::getProbes()
+{
+    return probes;
+}
+
+// [PUBLIC]
+std::uint64_t PawnTable::getHits()
+{
+    return hits;
+}
+
+static thread_local PawnTable* boundTable = nullptr;
+
+// [PUBLIC]
+PawnTable& PawnTable::threadTable()
+{
+    if (boundTable)
+        return *boundTable;
+    thread_local PawnTable table;
+    return table;
+}
+
+// [PUBLIC] search threads are started per search, so the cache is kept by the searcher rather than the thread
+void PawnTable::bindThreadTable(PawnTable* table)
+{
+    boundTable = table;
+}
+
+} // namespace search
+
+} // namespace gv
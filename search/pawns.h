@@ -0,0 +1,53 @@
+/* Pawn structure evaluation */
+#pragma once
+
+#include "../chessboard/chessboard.h"
+#include <memory>
+
+namespace gv
+{
+
+namespace search
+{
+
+// cache of pawn structure scores keyed by Board::pawnHash()
+// pawns move rarely between nodes so most lookups hit, each searcher has its own table that lasts across its searches
+class PawnTable
+{
+
+private:
+    struct Entry
+    {
+        std::uint64_t key;
+        chessboard::TaperedScore score;
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    std::uint64_t numEntries; // power of two
+    std::uint64_t probes;
+    std::uint64_t hits;
+
+public:
+    PawnTable(std::size_t kb = 256);
+
+    void clear();
+    chessboard::TaperedScore probe(chessboard::Board& board); // computes and stores the score on a miss
+
+    std::uint64_t getProbes();
+    std::uint64_t getHits();
+
+    // the table pawnStructureTerm uses on the calling thread, a searcher binds its own while it searches
+    // threads with none bound get one of their own on first use
+    static PawnTable& threadTable();
+    static void bindThreadTable(PawnTable* table); // null unbinds
+};
+
+// passed, isolated, doubled and backward pawns from white's point of view, computed from scratch
+chessboard::TaperedScore evaluatePawns(chessboard::Board& board);
+
+// evaluator term scoring the pawn structure through the pawn table bound to the calling thread
+chessboard::TaperedScore pawnStructureTerm(chessboard::Board& board);
+
+} // namespace search
+
+} // namespace gv
@@ -0,0 +1,436 @@
+#include "search.h"
+
+namespace gv
+{
+namespace search
+{
+
+/**************************************************************************************/
+// SEARCHER
+
+const std::vector<std::string> benchPositions = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2bppp/2n1pn2/2pp4/3P4/2PBPN2/PP1N1PPP/R1BQ1RK1 w - - 0 8",
+    "2r3k1/5pp1/p3p2p/1p1pP3/3P4/P1R2P2/1P4PP/6K1 w - - 0 30",
+};
+
+// material values for capture ordering indexed by chessboard::Piece
+static const int pieceValues[7] = { 100, 500, 320, 330, 900, 0, 0 };
+
+// ordering bands, captures and killers are always tried before history ordered quiet moves
+// captures that lose material in the exchange on their square are held back to the quiet stage, after the killers
+static const int ORDER_HASH = 1 << 30;
+static const int ORDER_PV = 1 << 29;
+static const int ORDER_CAPTURE = 1 << 28;
+static const int ORDER_KILLER = 1 << 27;
+static const int ORDER_LOSING_CAPTURE = 1 << 26;
+
+// history scores are halved once one reaches this, keeping them below the bands above and letting old cutoffs fade
+static const int HISTORY_MAX = 1 << 20;
+
+// mate scores are stored relative to the position rather than the root so they stay valid when reached by another path
+static int scoreToTT(int score, int ply)
+{
+    if (score >= SCORE_MATE - MAX_PLY)
+        return score + ply;
+    if (score <= -SCORE_MATE + MAX_PLY)
+        return score - ply;
+    return score;
+}
+
+static int scoreFromTT(int score, int ply)
+{
+    if (score >= SCORE_MATE - MAX_PLY)
+        return score - ply;
+    if (score <= -SCORE_MATE + MAX_PLY)
+        return score + ply;
+    return score;
+}
+
+// [PUBLIC]
+Searcher::Searcher(TranspositionTable* tt) : tt(tt), threadId(0), stopSignal(nullptr), nodes(0), stopFlag(false), aborted(false)
+{
+}
+
+// [PUBLIC] stops a running search, the result of the last completed iteration is returned
+void Searcher::stop()
+{
+    stopFlag = true;
+}
+
+// [PUBLIC]
+void Searcher::clearStop()
+{
+    stopFlag = false;
+}
+
+// [PUBLIC] sets the id used to diversify helper threads of a parallel search, 0 searches normally
+void Searcher::setThreadId(int id)
+{
+    threadId = id;
+}
+
+// [PUBLIC] the search also stops when this flag is set, it is not reset by the searcher
+void Searcher::setStopSignal(const std::atomic<bool>* signal)
+{
+    stopSignal = signal;
+}
+
+// [PUBLIC] replaces the evaluation used at the leaves, takes effect from the next search
+void Searcher::setEvaluator(const Evaluator& eval)
+{
+    evaluator = eval;
+}
+
+// [PUBLIC]
+void Searcher::setInfoCallback(InfoCallback callback)
+{
+    infoCallback = callback;
+}
+
+// [PUBLIC] iterative deepening search from the board's position, the board is returned in the same position
+SearchResult Searcher::search(chessboard::Board& board, SearchLimits limits)
+{
+    this->limits = limits;
+    startTime = std::chrono::steady_clock::now();
+    nodes = 0;
+    aborted = false;
+    PawnTable::bindThreadTable(&pawnTable);
+
+    std::memset(history, 0, sizeof(history));
+    for (int ply = 0; ply < MAX_PLY; ++ply)
+    {
+        killers[ply][0] = chessboard::PackedMove();
+        killers[ply][1] = chessboard::PackedMove();
+    }
+    prevPV.clear();
+
+    SearchResult result{}; // bestMove stays null if no iteration finds a move
+    result.score = 0;
+    result.depth = 0;
+
+    int maxDepth = std::min(std::max(limits.depth, 1), MAX_PLY - 1);
+    for (int depth = 1; depth <= maxDepth; ++depth)
+    {
+        // helper threads skip alternate depths so they run ahead of or behind the main thread and fill the table differently
+        if (threadId > 0 && depth > 1 && depth < maxDepth && (depth + threadId) % 2 == 0)
+            continue;
+
+        int score = negamax(board, depth, -SCORE_INF, SCORE_INF, 0);
+
+        // a partial iteration is thrown away, except that the first iteration always gives a move
+        if (aborted && depth > 1)
+            break;
+
+        result.score = score;
+        result.depth = depth;
+        result.pv.assign(pvTable[0], pvTable[0] + pvLength[0]);
+        if (!result.pv.empty())
+            result.bestMove = result.pv[0];
+        prevPV = result.pv;
+
+        if (infoCallback)
+        {
+            result.nodes = nodes;
+            result.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            infoCallback(result);
+        }
+
+        // no need to search deeper once a forced mate has been found
+        if (aborted || std::abs(score) >= SCORE_MATE - MAX_PLY)
+            break;
+    }
+
+    // stopped before the first iteration found a move, any valid move is better than none
+    if (result.bestMove.isNull())
+    {
+        chessboard::MoveList mvs;
+        board.generateMoves(mvs);
+        if (mvs.size > 0)
+            result.bestMove = mvs[0];
+    }
+
+    PawnTable::bindThreadTable(nullptr);
+    result.nodes = nodes;
+    result.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return result;
+}
+
+// [PRIVATE] halves every history score
+void Searcher::ageHistory()
+{
+    for (auto& plrHistory : history)
+    {
+        for (auto& fromHistory : plrHistory)
+        {
+            for (auto& score : fromHistory)
+                score /= 2;
+        }
+    }
+}
+
+// [PRIVATE] returns true once any limit has been reached, time is only checked every few thousand nodes
+bool Searcher::checkLimits()
+{
+    if (stopFlag || (stopSignal && *stopSignal) || (limits.nodes > 0 && nodes >= limits.nodes))
+    {
+        aborted = true;
+    }
+    else if (limits.movetime > 0 && (nodes & 2047) == 0)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+        if (elapsed >= limits.movetime)
+            aborted = true;
+    }
+    return aborted;
+}
+
+// [PRIVATE] fail-hard alpha-beta search, scores are from the point of view of the player to move
+int Searcher::negamax(chessboard::Board& board, int depth, int alpha, int beta, int ply)
+{
+    pvLength[ply] = 0;
+
+    // a line that repeats a position can be repeated again, so it is cut as a draw at once
+    if (ply > 0 && (board.isRepetition() || board.isFiftyMoveDraw()))
+        return std::max(alpha, std::min(beta, 0));
+
+    if (depth <= 0 || ply >= MAX_PLY - 1)
+        return quiesce(board, alpha, beta, ply);
+
+    nodes++;
+    if (checkLimits())
+        return 0;
+
+    // a deep enough result for this position may already be known, the root is always searched to get a move
+    TTEntry ttEntry;
+    chessboard::PackedMove hashMove = chessboard::PackedMove();
+    if (tt && tt->probe(board.hash(), ttEntry))
+    {
+        hashMove = ttEntry.mv;
+        int ttScore = scoreFromTT(ttEntry.score, ply);
+        if (ply > 0 && ttEntry.depth >= depth)
+        {
+            if (ttEntry.bound == BOUND_EXACT
+                || (ttEntry.bound == BOUND_LOWER && ttScore >= beta)
+                || (ttEntry.bound == BOUND_UPPER && ttScore <= alpha))
+            {
+                return std::max(alpha, std::min(beta, ttScore));
+            }
+        }
+    }
+
+    // moves are searched in stages, so a cutoff by the hash move or a capture skips generating the quiet moves
+    chessboard::Player plr = board.getPlayerToMove();
+    chessboard::PackedMove bestMove = chessboard::PackedMove();
+    Bound bound = BOUND_UPPER;
+    int numMoves = 0;
+    for (int stage = STAGE_HASH; stage <= STAGE_QUIETS; ++stage)
+    {
+        generateMoves(board, ply, (Stage)stage, hashMove);
+        for (int i = 0; i < numPlyMoves[ply]; ++i)
+        {
+            chessboard::PackedMove mv = pickMove(ply, i);
+            numMoves++;
+
+            board.makeMove(mv);
+            int score = -negamax(board, depth - 1, -beta, -alpha, ply + 1);
+            board.unmakeMove();
+
+            if (aborted)
+                return 0;
+
+            if (score >= beta)
+            {
+                // quiet moves that cause a cutoff are likely to do so in sibling positions too
+                if (!mv.isCapture() && !mv.isPromotion())
+                {
+                    if (killers[ply][0] != mv)
+                    {
+                        killers[ply][1] = killers[ply][0];
+                        killers[ply][0] = mv;
+                    }
+                    int& entry = history[plr][mv.start()][mv.end()];
+                    entry += depth*depth;
+                    if (entry >= HISTORY_MAX)
+                        ageHistory();
+                }
+                if (tt)
+                    tt->store(board.hash(), mv, scoreToTT(beta, ply), depth, BOUND_LOWER);
+                return beta;
+            }
+
+            if (score > alpha)
+            {
+                alpha = score;
+                bestMove = mv;
+                bound = BOUND_EXACT;
+
+                pvTable[ply][0] = mv;
+                for (int k = 0; k < pvLength[ply + 1]; ++k)
+                {
+                    pvTable[ply][k + 1] = pvTable[ply + 1][k];
+                }
+                pvLength[ply] = pvLength[ply + 1] + 1;
+            }
+        }
+    }
+
+    if (numMoves == 0)
+    {
+        // checkmate or stalemate, prefer the quickest mate
+        return (board.getCheck() == board.getPlayerToMove()) ? -SCORE_MATE + ply : 0;
+    }
+
+    if (tt)
+        tt->store(board.hash(), bestMove, scoreToTT(alpha, ply), depth, bound);
+    return alpha;
+}
+
+// [PRIVATE] searches captures only until the position is quiet so the horizon does not cut an exchange in half
+int Searcher::quiesce(chessboard::Board& board, int alpha, int beta, int ply)
+{
+    pvLength[ply] = 0;
+
+    nodes++;
+    if (checkLimits())
+        return 0;
+
+    // in check the position isn't quiet, so there's no standing pat and every evasion is searched
+    bool inCheck = (board.getCheck() == board.getPlayerToMove());
+    if (inCheck == false || ply >= MAX_PLY - 1)
+    {
+        int standPat = evaluator.evaluate(board);
+        if (standPat >= beta || ply >= MAX_PLY - 1)
+            return (standPat >= beta) ? beta : standPat;
+        if (standPat > alpha)
+            alpha = standPat;
+    }
+
+    generateMoves(board, ply, STAGE_QUIESCE, chessboard::PackedMove());
+    int numMoves = numPlyMoves[ply];
+    if (numMoves == 0 && inCheck)
+        return -SCORE_MATE + ply;
+    for (int i = 0; i < numMoves; ++i)
+    {
+        chessboard::PackedMove mv = pickMove(ply, i);
+
+        board.makeMove(mv);
+        int score = -quiesce(board, -beta, -alpha, ply + 1);
+        board.unmakeMove();
+
+        if (aborted)
+            return 0;
+        if (score >= beta)
+            return beta;
+        if (score > alpha)
+            alpha = score;
+    }
+    return alpha;
+}
+
+// [PRIVATE] fills the ply's move list with the scored moves of a stage, the hash move is its own stage
+// captures are ordered most valuable victim / least valuable attacker, quiet moves by killers then history
+void Searcher::generateMoves(chessboard::Board& board, int ply, Stage stage, chessboard::PackedMove hashMove)
+{
+    numPlyMoves[ply] = 0;
+    if (stage == STAGE_HASH || stage == STAGE_CAPTURES)
+        numLosingCaptures[ply] = 0;
+
+    if (stage == STAGE_HASH)
+    {
+        if (!hashMove.isNull() && board.isValidMove(hashMove))
+            plyMoves[ply][numPlyMoves[ply]++] = { hashMove, ORDER_HASH };
+        return;
+    }
+
+    // in check every evasion is generated with the captures, leaving the quiet stage empty, quiescence takes them all too
+    chessboard::Player plr = board.getPlayerToMove();
+    bool evading = (board.getCheck() == plr);
+    if (evading)
+    {
+        if (stage == STAGE_QUIETS)
+            return;
+        board.generateEvasions(validMoves);
+    }
+    else if (stage == STAGE_QUIETS)
+    {
+        board.generateMoves(validMoves, chessboard::GEN_QUIETS);
+        for (int i = 0; i < numLosingCaptures[ply]; ++i)
+            plyMoves[ply][numPlyMoves[ply]++] = { losingCaptures[ply][i], ORDER_LOSING_CAPTURE };
+    }
+    else
+    {
+        board.generateCaptures(validMoves);
+    }
+
+    chessboard::PackedMove pvMove = (ply < (int)prevPV.size()) ? prevPV[ply] : chessboard::PackedMove();
+
+    for (auto mv : validMoves)
+    {
+        bool capture = mv.isCapture();
+        bool promotion = mv.isPromotion();
+
+        // under-promotions are only worth looking at in the main search
+        if (mv == hashMove || (stage == STAGE_QUIESCE && !evading && promotion && mv.promotion() != chessboard::QUEEN))
+            continue;
+
+        int score;
+        if (mv == pvMove)
+        {
+            score = ORDER_PV;
+        }
+        else if (capture || promotion)
+        {
+            chessboard::Piece attacker = board.getSqrPiece(mv.start());
+            chessboard::Piece victim = (mv.flags() == chessboard::ENPSSNT) ? chessboard::PAWN : board.getSqrPiece(mv.end());
+            score = 10*pieceValues[victim] - pieceValues[attacker] + pieceValues[mv.promotion()];
+
+            // taking a piece worth at least the attacker never loses material, otherwise check the exchange
+            bool losing = (pieceValues[victim] < pieceValues[attacker] && attacker != chessboard::KING && board.see(mv) < 0);
+            if (losing && stage == STAGE_QUIESCE && !evading)
+                continue; // losing captures are not searched in quiescence
+            if (losing && !evading)
+            {
+                losingCaptures[ply][numLosingCaptures[ply]++] = mv;
+                continue;
+            }
+            score += losing ? ORDER_LOSING_CAPTURE : ORDER_CAPTURE;
+        }
+        else if (mv == killers[ply][0] || mv == killers[ply][1])
+        {
+            score = ORDER_KILLER;
+        }
+        else
+        {
+            score = history[plr][mv.start()][mv.end()];
+
+            // small per thread perturbation so helper threads do not all walk the same tree
+            if (threadId > 0)
+                score += (mv.start()*7 + mv.end()*13 + threadId*29) & 15;
+        }
+        plyMoves[ply][numPlyMoves[ply]++] = { mv, score };
+    }
+}
+
+// [PRIVATE] selection sort step, moves the best scored remaining move to index and returns it
+chessboard::PackedMove Searcher::pickMove(int ply, int index)
+{
+    ScoredMove* mvs = plyMoves[ply];
+    int best = index;
+    for (int i = index + 1; i < numPlyMoves[ply]; ++i)
+    {
+        if (mvs[i].score > mvs[best].score)
+            best = i;
+    }
+    std::swap(mvs[index], mvs[best]);
+    return mvs[index].mv;
+}
+
+} // namespace search
+
+} // namespace gv
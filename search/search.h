@@ -0,0 +1,118 @@
+/* Chess search library */
+#pragma once
+
+#include "../chessboard/chessboard.h"
+#include "tt.h"
+#include "eval.h"
+#include "pawns.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+namespace gv
+{
+
+namespace search
+{
+
+const int MAX_PLY = 64;
+const int SCORE_INF = 32000;
+const int SCORE_MATE = 31000; // mate in n plies scores SCORE_MATE - n
+
+// the perft reference positions plus a few quieter middlegame and endgame positions, searched by the bench commands
+// of the bench and uci tools so their node counts can be compared
+extern const std::vector<std::string> benchPositions;
+
+// a zero limit is no limit, the search stops when the first limit is reached
+struct SearchLimits
+{
+    int depth;
+    long long nodes;
+    int movetime; // milliseconds
+
+    SearchLimits() : depth(MAX_PLY - 1), nodes(0), movetime(0) {}
+};
+
+struct SearchResult
+{
+    chessboard::PackedMove bestMove; // null move if there are no valid moves
+    int score; // centipawns from the point of view of the player to move
+    int depth; // last completed iteration
+    long long nodes;
+    double time; // seconds
+    std::vector<chessboard::PackedMove> pv;
+};
+
+// called after each completed iteration with the result so far, nodes and time included
+typedef std::function<void(const SearchResult&)> InfoCallback;
+
+class Searcher
+{
+
+private:
+    struct ScoredMove
+    {
+        chessboard::PackedMove mv;
+        int score;
+    };
+
+    // move generation stages of a node, quiescence only generates captures and queen promotions
+    // when in check all evasions are generated in the captures stage
+    enum Stage
+    {
+        STAGE_HASH, STAGE_CAPTURES, STAGE_QUIETS, STAGE_QUIESCE
+    };
+
+    TranspositionTable* tt; // shared between searchers, may be null, aged with newSearch by whoever runs the searches
+    Evaluator evaluator;
+    PawnTable pawnTable; // bound to the searching thread during a search, kept from one search to the next
+    InfoCallback infoCallback;
+    int threadId; // 0 for a main search, helper threads of a parallel search vary their depths and ordering by id
+    const std::atomic<bool>* stopSignal; // optional stop flag shared by several searchers
+    SearchLimits limits;
+    std::chrono::steady_clock::time_point startTime;
+    long long nodes;
+    std::atomic<bool> stopFlag;
+    bool aborted;
+
+    // buffers reused across the search so nodes do not allocate
+    chessboard::MoveList validMoves;
+    ScoredMove plyMoves[MAX_PLY][chessboard::MAX_MOVES];
+    int numPlyMoves[MAX_PLY];
+    chessboard::PackedMove losingCaptures[MAX_PLY][chessboard::MAX_MOVES]; // held back from the captures stage
+    int numLosingCaptures[MAX_PLY];
+
+    // move ordering
+    chessboard::PackedMove killers[MAX_PLY][2];
+    int history[2][64][64]; // [player][start][end], bumped by quiet moves that cause a cutoff
+    std::vector<chessboard::PackedMove> prevPV;
+
+    // triangular principal variation table
+    chessboard::PackedMove pvTable[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+
+public:
+    Searcher(TranspositionTable* tt = nullptr);
+
+    SearchResult search(chessboard::Board& board, SearchLimits limits);
+    void stop(); // may be called from another thread, stays in effect until clearStop
+    void clearStop(); // call before starting the search, so a stop sent while it is starting up is not lost
+
+    void setThreadId(int id);
+    void setStopSignal(const std::atomic<bool>* signal);
+    void setEvaluator(const Evaluator& eval);
+    void setInfoCallback(InfoCallback callback); // called from the searching thread
+
+private:
+    int negamax(chessboard::Board& board, int depth, int alpha, int beta, int ply);
+    int quiesce(chessboard::Board& board, int alpha, int beta, int ply);
+
+    void generateMoves(chessboard::Board& board, int ply, Stage stage, chessboard::PackedMove hashMove);
+    chessboard::PackedMove pickMove(int ply, int index);
+    bool checkLimits();
+    void ageHistory();
+};
+
+} // namespace search
+
+} // namespace gv
@@ -0,0 +1,112 @@
+#include "smp.h"
+#include <thread>
+
+namespace gv
+{
+namespace search
+{
+
+/**************************************************************************************/
+// PARALLEL SEARCH
+
+// [PUBLIC]
+ParallelSearch::ParallelSearch(TranspositionTable* tt, int numThreads) : tt(tt), stopSignal(false)
+{
+    setThreads(numThreads);
+}
+
+// [PUBLIC] searchers keep their move ordering buffers between searches so they are only created when the count changes
+void ParallelSearch::setThreads(int numThreads)
+{
+    numThreads = std::max(numThreads, 1);
+    searchers.resize(numThreads);
+    for (int i = 0; i < numThreads; ++i)
+    {
+        if (!searchers[i])
+        {
+            searchers[i].reset(new Searcher(tt));
+            searchers[i]->setThreadId(i);
+            searchers[i]->setStopSignal(&stopSignal);
+            searchers[i]->setEvaluator(evaluator);
+        }
+    }
+}
+
+// [PUBLIC]
+int ParallelSearch::getThreads()
+{
+    return searchers.size();
+}
+
+// [PUBLIC]
+void ParallelSearch::setEvaluator(const Evaluator& eval)
+{
+    evaluator = eval;
+    for (auto& searcher : searchers)
+    {
+        searcher->setEvaluator(evaluator);
+    }
+}
+
+// [PUBLIC] only the main thread reports, its nodes do not include the helpers'
+void ParallelSearch::setInfoCallback(InfoCallback callback)
+{
+    searchers[0]->setInfoCallback(callback);
+}
+
+// [PUBLIC] searches with all threads until the main thread reaches its limits, the board is returned in the same position
+SearchResult ParallelSearch::search(chessboard::Board& board, SearchLimits limits)
+{
+    // helpers have no limits of their own, they run until the main thread is done
+    SearchLimits helperLimits;
+    helperLimits.depth = limits.depth;
+
+    // the table is aged once before any thread stores, so every entry of this search carries the new generation
+    if (tt)
+        tt->newSearch();
+
+    std::vector<chessboard::Board> boards(searchers.size() - 1, board);
+    std::vector<std::thread> helpers;
+    std::vector<long long> helperNodes(searchers.size() - 1, 0);
+    for (int i = 1; i < (int)searchers.size(); ++i)
+    {
+        searchers[i]->clearStop(); // helpers are stopped through their own flag, cleared before they start
+        helpers.emplace_back([this, i, &boards, &helperNodes, helperLimits]()
+        {
+            helperNodes[i - 1] = searchers[i]->search(boards[i - 1], helperLimits).nodes;
+        });
+    }
+
+    SearchResult result = searchers[0]->search(board, limits);
+
+    for (int i = 1; i < (int)searchers.size(); ++i)
+    {
+        searchers[i]->stop();
+    }
+    for (auto& helper : helpers)
+    {
+        helper.join();
+    }
+    for (auto n : helperNodes)
+    {
+        result.nodes += n;
+    }
+    return result;
+}
+
+// [PUBLIC] stops a running search, the result of the main thread's last completed iteration is returned
+void ParallelSearch::stop()
+{
+    stopSignal = true;
+}
+
+// [PUBLIC]
+void ParallelSearch::clearStop()
+{
+    stopSignal = false;
+    searchers[0]->clearStop();
+}
+
+} // namespace search
+
+} // namespace gv
@@ -0,0 +1,39 @@
+/* Lazy SMP parallel search */
+#pragma once
+
+#include "search.h"
+#include <memory>
+
+namespace gv
+{
+
+namespace search
+{
+
+// runs several searchers on copies of the same position, sharing one transposition table
+// helper threads only fill the table, the result is that of the main thread with the nodes of all threads
+class ParallelSearch
+{
+
+private:
+    TranspositionTable* tt;
+    std::vector<std::unique_ptr<Searcher>> searchers;
+    std::atomic<bool> stopSignal;
+    Evaluator evaluator;
+
+public:
+    ParallelSearch(TranspositionTable* tt, int numThreads = 1);
+
+    void setThreads(int numThreads);
+    int getThreads();
+    void setEvaluator(const Evaluator& eval); // used by every thread, including ones added later
+    void setInfoCallback(InfoCallback callback); // reports the main thread's iterations
+
+    SearchResult search(chessboard::Board& board, SearchLimits limits);
+    void stop(); // may be called from another thread, stays in effect until clearStop
+    void clearStop(); // call before starting the search, so a stop sent while it is starting up is not lost
+};
+
+} // namespace search
+
+} // namespace gv
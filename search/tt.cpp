@@ -0,0 +1,234 @@
+#include "tt.h"
+
+namespace gv
+{
+namespace search
+{
+
+/**************************************************************************************/
+// ENTRY PACKING
+
+// data word layout:
+// bits  0-15  best move (chessboard::PackedMove), 0 if none
+// bits 16-31  score
+// bits 32-39  depth
+// bits 40-41  bound
+// bits 42-47  generation
+
+static std::uint64_t packData(chessboard::PackedMove mv, int score, int depth, Bound bound, unsigned int generation)
+{
+    std::uint64_t data = mv.data;
+    data |= std::uint64_t(std::uint16_t(std::int16_t(score))) << 16;
+    data |= std::uint64_t(std::uint8_t(std::max(depth, 0))) << 32;
+    data |= std::uint64_t(bound) << 40;
+    data |= std::uint64_t(generation & 63) << 42;
+    return data;
+}
+
+static void unpackData(std::uint64_t data, TTEntry& entry)
+{
+    entry.mv.data = std::uint16_t(data);
+    entry.score = std::int16_t(std::uint16_t(data >> 16));
+    entry.depth = (data >> 32) & 255;
+    entry.bound = (Bound)((data >> 40) & 3);
+}
+
+static unsigned int dataGeneration(std::uint64_t data)
+{
+    return (data >> 42) & 63;
+}
+
+static int dataDepth(std::uint64_t data)
+{
+    return (data >> 32) & 255;
+}
+
+/**************************************************************************************/
+// TRANSPOSITION TABLE
+
+// [PUBLIC]
+TranspositionTable::TranspositionTable(std::size_t mb) : numBuckets(0), generation(0)
+{
+    resize(mb);
+}
+
+// [PUBLIC] reallocates the table to the largest power of two number of buckets that fits in the size, clearing it
+void TranspositionTable::resize(std::size_t mb)
+{
+    std::uint64_t bytes = std::uint64_t(std::max<std::size_t>(mb, 1)) << 20;
+    std::uint64_t n = 1;
+    while (n*2*sizeof(Bucket) <= bytes)
+    {
+        n *= 2;
+    }
+
+    if (n != numBuckets)
+    {
+        buckets.reset(); // release the old table before allocating the new one
+        buckets.reset(new Bucket[n]);
+        numBuckets = n;
+    }
+    clear();
+}
+
+// [PUBLIC] empties the table and resets the statistics
+void TranspositionTable::clear()
+{
+    for (std::uint64_t i = 0; i < numBuckets; ++i)
+    {
+        for (auto& slot : buckets[i].slots)
+        {
+            slot.check.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+    }
+    generation = 0;
+    resetStats();
+}
+
+// [PUBLIC] ages the table, entries from previous searches are replaced first
+void TranspositionTable::newSearch()
+{
+    generation.store((generation.load(std::memory_order_relaxed) + 1) & 63, std::memory_order_relaxed);
+}
+
+// [PUBLIC] returns true and fills the entry if the key is in the table
+bool TranspositionTable::probe(std::uint64_t key, TTEntry& entry)
+{
+    StatShard& shard = statShard();
+    shard.probes.fetch_add(1, std::memory_order_relaxed);
+
+    Bucket& bucket = buckets[key & (numBuckets - 1)];
+    for (auto& slot : bucket.slots)
+    {
+        std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+        std::uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && data != 0)
+        {
+            unpackData(data, entry);
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+// [PUBLIC] stores a search result, replacing the same position or else the stalest, shallowest entry in the bucket
+void TranspositionTable::store(std::uint64_t key, chessboard::PackedMove mv, int score, int depth, Bound bound)
+{
+    statShard().stores.fetch_add(1, std::memory_order_relaxed);
+
+    Bucket& bucket = buckets[key & (numBuckets - 1)];
+    Slot* replace = &bucket.slots[0];
+    int replaceValue = 1 << 30;
+    for (auto& slot : bucket.slots)
+    {
+        std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+        std::uint64_t check = slot.check.load(std::memory_order_relaxed);
+
+        if ((check ^ data) == key || data == 0)
+        {
+            // keep the best move already known for this position if the new result has none
+            if (data != 0 && mv.isNull())
+            {
+                mv.data = std::uint16_t(data);
+            }
+            replace = &slot;
+            break;
+        }
+
+        // entries from older searches lose 8 plies of depth per generation
+        int age = (generation.load(std::memory_order_relaxed) - dataGeneration(data)) & 63;
+        int value = dataDepth(data) - 8*age;
+        if (value < replaceValue)
+        {
+            replaceValue = value;
+            replace = &slot;
+        }
+    }
+
+    std::uint64_t data = packData(mv, score, depth, bound, generation.load(std::memory_order_relaxed));
+    replace->check.store(key ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
+
+// [PUBLIC]
+std::size_t TranspositionTable::getSizeMB()
+{
+    return (numBuckets*sizeof(Bucket)) >> 20;
+}
+
+// [PUBLIC]
+std::uint64_t TranspositionTable::getProbes()
+{
+    std::uint64_t n = 0;
+    for (auto& shard : stats)
+        n += shard.probes.load(std::memory_order_relaxed);
+    return n;
+}
+
+// [PUBLIC]
+std::uint64_t TranspositionTable::getHits()
+{
+    std::uint64_t n = 0;
+    for (auto& shard : stats)
+        n += shard.hits.load(std::memory_order_relaxed);
+    return n;
+}
+
+// [PUBLIC]
+std::uint64_t TranspositionTable::getStores()
+{
+    std::uint64_t n = 0;
+    for (auto& shard : stats)
+        n += shard.stores.load(std::memory_order_relaxed);
+    return n;
+}
+
+// [PUBLIC] fraction of probes that found their position
+double TranspositionTable::getHitRate()
+{
+    std::uint64_t probes = getProbes();
+    return (probes == 0) ? 0.0 : double(getHits()) / probes;
+}
+
+// [PUBLIC] samples the first thousand buckets for slots written during the current search
+int TranspositionTable::getHashfull()
+{
+    int used = 0;
+    int total = 0;
+    for (std::uint64_t i = 0; i < std::min<std::uint64_t>(numBuckets, 1000 / SLOTS_PER_BUCKET); ++i)
+    {
+        for (auto& slot : buckets[i].slots)
+        {
+            std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+            if (data != 0 && dataGeneration(data) == generation.load(std::memory_order_relaxed))
+                used++;
+            total++;
+        }
+    }
+    return (total == 0) ? 0 : used*1000 / total;
+}
+
+// [PUBLIC]
+void TranspositionTable::resetStats()
+{
+    for (auto& shard : stats)
+    {
+        shard.probes.store(0, std::memory_order_relaxed);
+        shard.hits.store(0, std::memory_order_relaxed);
+        shard.stores.store(0, std::memory_order_relaxed);
+    }
+}
+
+// [PRIVATE] each thread is given its own statistics shard the first time it touches any table
+TranspositionTable::StatShard& TranspositionTable::statShard()
+{
+    static std::atomic<int> nextShard(0);
+    thread_local int shard = nextShard.fetch_add(1, std::memory_order_relaxed) % STAT_SHARDS;
+    return stats[shard];
+}
+
+} // namespace search
+
+} // namespace gv
@@ -0,0 +1,86 @@
+/* Transposition table shared between search threads */
+#pragma once
+
+#include "../chessboard/chessboard.h"
+#include <atomic>
+#include <memory>
+
+namespace gv
+{
+
+namespace search
+{
+
+enum Bound
+{
+    BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT
+};
+
+struct TTEntry
+{
+    chessboard::PackedMove mv; // null move if no best move is known
+    int score;
+    int depth;
+    Bound bound;
+};
+
+// fixed size hash table of search results keyed by Board::hash()
+// entries are two 64-bit words, the key is stored xor'd with the data so a torn write from
+// another thread fails verification on probe instead of needing a lock
+class TranspositionTable
+{
+
+private:
+    struct Slot
+    {
+        std::atomic<std::uint64_t> check; // key ^ data
+        std::atomic<std::uint64_t> data;
+    };
+
+    static const int SLOTS_PER_BUCKET = 4;
+
+    struct alignas(64) Bucket
+    {
+        Slot slots[SLOTS_PER_BUCKET];
+    };
+
+    // statistics are sharded per thread so counting does not bounce a shared cache line between threads
+    static const int STAT_SHARDS = 16;
+
+    struct alignas(64) StatShard
+    {
+        std::atomic<std::uint64_t> probes;
+        std::atomic<std::uint64_t> hits;
+        std::atomic<std::uint64_t> stores;
+    };
+
+    std::unique_ptr<Bucket[]> buckets;
+    std::uint64_t numBuckets; // power of two
+    std::atomic<unsigned int> generation; // 6 bits, bumped by newSearch to age out old entries
+    StatShard stats[STAT_SHARDS];
+
+public:
+    TranspositionTable(std::size_t mb = 16);
+
+    void resize(std::size_t mb);
+    void clear();
+    void newSearch();
+
+    bool probe(std::uint64_t key, TTEntry& entry);
+    void store(std::uint64_t key, chessboard::PackedMove mv, int score, int depth, Bound bound);
+
+    std::size_t getSizeMB();
+    std::uint64_t getProbes();
+    std::uint64_t getHits();
+    std::uint64_t getStores();
+    double getHitRate();
+    int getHashfull(); // permille of sampled slots used by the current search
+    void resetStats();
+
+private:
+    StatShard& statShard();
+};
+
+} // namespace search
+
+} // namespace gv
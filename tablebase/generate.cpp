@@ -0,0 +1,418 @@
+#include "tablebase.h"
+#include <atomic>
+#include <thread>
+
+namespace gv
+{
+namespace tablebase
+{
+
+using chessboard::Bitboard;
+using chessboard::Piece;
+using chessboard::Player;
+
+/**************************************************************************************/
+// MOVES
+
+static Bitboard pieceAttacks(Piece piece, Player owner, int sq, Bitboard occ)
+{
+    switch (piece)
+    {
+        case chessboard::PAWN:   return chessboard::pawnAttacks(owner, sq);
+        case chessboard::KNIGHT: return chessboard::knightAttacks(sq);
+        case chessboard::BISHOP: return chessboard::bishopAttacks(sq, occ);
+        case chessboard::ROOK:   return chessboard::rookAttacks(sq, occ);
+        case chessboard::QUEEN:  return chessboard::rookAttacks(sq, occ) | chessboard::bishopAttacks(sq, occ);
+        default:                 return chessboard::kingAttacks(sq);
+    }
+}
+
+static const Piece promotionPieces[] = { chessboard::QUEEN, chessboard::ROOK, chessboard::BISHOP, chessboard::KNIGHT };
+
+// signature of the men left after a capture and or a promotion, captured is -1 for none
+static std::string convertedName(const Layout& layout, int captured, int promoted, Piece promotion)
+{
+    std::string sides[2] = { "K", "K" };
+    for (int s = 2; s < layout.men; ++s)
+    {
+        if (s == captured)
+            continue;
+        Piece piece = (s == promoted) ? promotion : layout.pieces[s];
+        sides[layout.owners[s]] += "PRNBQ"[piece];
+    }
+    return sides[0] + "v" + sides[1];
+}
+
+/**************************************************************************************/
+// GENERATOR
+
+// retrograde analysis of one table
+// every legal position is first scored from its moves that leave the table (captures and promotions) and checkmates,
+// then positions are taken in order of their distance to mate and the moves leading to them are walked backwards:
+// a predecessor of a lost position is won one ply further on, and a predecessor of a won position is lost once all of
+// its moves lead to won positions, checked by generating its moves forwards
+// each pass splits the table between the threads, a position is only ever changed to a value beyond the pass's distance
+// so the positions being read by a pass are never written during it
+class Generator
+{
+
+private:
+    const Layout& layout;
+    const Tablebases& tbs;
+    int numThreads;
+    std::unique_ptr<std::atomic<std::uint8_t>[]> values; // [player to move][index]
+    std::atomic<int> maxPlies; // longest distance stored so far
+    std::atomic<bool> overflow;
+
+public:
+    Generator(const Layout& layout, const Tablebases& tbs, int numThreads) : layout(layout), tbs(tbs), numThreads(numThreads),
+        values(new std::atomic<std::uint8_t>[2*layout.size]), maxPlies(0), overflow(false) {}
+
+    bool run()
+    {
+        std::size_t size = layout.size;
+        parallelFor(2*size, [&](std::size_t i)
+        {
+            int sqrs[MAX_MEN];
+            layout.decode(i % size, sqrs);
+            bool canonical = (layout.index(sqrs) == i % size); // the other entries of mirrored positions are never used
+            values[i].store((canonical && isLegal(sqrs, Player(i / size))) ? VAL_DRAW : VAL_ILLEGAL, std::memory_order_relaxed);
+        });
+
+        // checkmates and positions decided by their captures and promotions alone
+        parallelFor(2*size, [&](std::size_t i)
+        {
+            if (values[i].load(std::memory_order_relaxed) == VAL_ILLEGAL)
+                return;
+            int sqrs[MAX_MEN];
+            layout.decode(i % size, sqrs);
+            store(values[i], score(sqrs, Player(i / size), -1));
+        });
+
+        for (int level = 0; level <= maxPlies && !overflow; ++level)
+        {
+            parallelFor(2*size, [&](std::size_t i)
+            {
+                if (values[i].load(std::memory_order_relaxed) == level + 1)
+                    propagate(i, level);
+            });
+        }
+        return !overflow;
+    }
+
+    std::vector<std::uint8_t> result(GenerationStats& stats)
+    {
+        std::vector<std::uint8_t> vals(2*layout.size);
+        stats = { 0, 0, 0, 0 };
+        for (std::size_t i = 0; i < vals.size(); ++i)
+        {
+            vals[i] = values[i].load(std::memory_order_relaxed);
+            if (vals[i] == VAL_ILLEGAL)
+                continue;
+            if (vals[i] == VAL_DRAW)
+            {
+                stats.draws++;
+                continue;
+            }
+            int plies = vals[i] - 1;
+            ((plies & 1) ? stats.wins : stats.losses)++;
+            stats.longestMate = std::max(stats.longestMate, plies);
+        }
+        return vals;
+    }
+
+private:
+    // calls f(i) for i in 0..n-1, threads take chunks of indices from a shared counter
+    template<typename F>
+    void parallelFor(std::size_t n, F f)
+    {
+        const std::size_t CHUNK = 1 << 14;
+        std::atomic<std::size_t> next(0);
+        auto worker = [&]()
+        {
+            for (std::size_t start = next.fetch_add(CHUNK); start < n; start = next.fetch_add(CHUNK))
+            {
+                for (std::size_t i = start; i < std::min(start + CHUNK, n); ++i)
+                {
+                    f(i);
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int t = 1; t < numThreads; ++t)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    Bitboard occupancy(const int* sqrs, Player plr)
+    {
+        Bitboard occ = 0;
+        for (int s = 0; s < layout.men; ++s)
+        {
+            if (layout.owners[s] == plr)
+                occ |= chessboard::sqrBB(sqrs[s]);
+        }
+        return occ;
+    }
+
+    bool isAttacked(const int* sqrs, Bitboard occ, int target, Player by)
+    {
+        for (int s = 0; s < layout.men; ++s)
+        {
+            if (layout.owners[s] == by && (pieceAttacks(layout.pieces[s], by, sqrs[s], occ) & chessboard::sqrBB(target)))
+                return true;
+        }
+        return false;
+    }
+
+    // false if men share a square, a pawn is on the first or last rank or the player not to move is in check
+    bool isLegal(const int* sqrs, Player plrToMove)
+    {
+        Bitboard occ = occupancy(sqrs, chessboard::WHITE) | occupancy(sqrs, chessboard::BLACK);
+        if (chessboard::popCount(occ) != layout.men)
+            return false;
+        for (int s = 0; s < layout.men; ++s)
+        {
+            int rank = sqrs[s] >> 3;
+            if (layout.pieces[s] == chessboard::PAWN && (rank == 0 || rank == 7))
+                return false;
+        }
+        return !isAttacked(sqrs, occ, sqrs[chessboard::opponent(plrToMove)], plrToMove); // slots 0 and 1 are the white and black kings
+    }
+
+    // scores a position from the values of the positions its moves lead to, VAL_DRAW while it is still undecided
+    // distances of wins within the table longer than level may still shorten, so they don't count as final yet
+    std::uint8_t score(const int* sqrs, Player plr, int level)
+    {
+        Bitboard occ[2] = { occupancy(sqrs, chessboard::WHITE), occupancy(sqrs, chessboard::BLACK) };
+        Bitboard all = occ[0] | occ[1];
+        bool anyLegal = false;
+        bool allLost = true;
+        int bestWin = -1;
+        int worstLoss = 0;
+
+        auto consider = [&](std::uint8_t val, bool inTable)
+        {
+            if (val == VAL_ILLEGAL)
+                return;
+            anyLegal = true;
+            int plies = val - 1;
+            if (val == VAL_DRAW)
+                allLost = false;
+            else if ((plies & 1) == 0)
+                bestWin = (bestWin < 0) ? plies + 1 : std::min(bestWin, plies + 1);
+            else if (inTable && plies > level)
+                allLost = false;
+            else
+                worstLoss = std::max(worstLoss, plies + 1);
+        };
+
+        int forward = (plr == chessboard::WHITE) ? 8 : -8;
+        int lastRank = (plr == chessboard::WHITE) ? 7 : 0;
+        for (int s = 0; s < layout.men; ++s)
+        {
+            if (layout.owners[s] != plr)
+                continue;
+            Piece piece = layout.pieces[s];
+            int from = sqrs[s];
+
+            Bitboard targets;
+            if (piece == chessboard::PAWN)
+            {
+                targets = chessboard::pawnAttacks(plr, from) & occ[chessboard::opponent(plr)];
+                int one = from + forward;
+                if ((all & chessboard::sqrBB(one)) == 0)
+                {
+                    targets |= chessboard::sqrBB(one);
+                    if ((from >> 3) == lastRank - 6*(forward/8) && (all & chessboard::sqrBB(one + forward)) == 0)
+                        targets |= chessboard::sqrBB(one + forward);
+                }
+            }
+            else
+            {
+                targets = pieceAttacks(piece, plr, from, all) & ~occ[plr];
+            }
+
+            while (targets)
+            {
+                int to = chessboard::popLsb(targets);
+                int captured = -1;
+                for (int c = 0; c < layout.men; ++c)
+                {
+                    if (sqrs[c] == to)
+                        captured = c;
+                }
+                bool promotion = (piece == chessboard::PAWN && (to >> 3) == lastRank);
+
+                int child[MAX_MEN];
+                std::copy(sqrs, sqrs + layout.men, child);
+                child[s] = to;
+                if (captured < 0 && !promotion)
+                {
+                    consider(values[chessboard::opponent(plr)*layout.size + layout.index(child)].load(std::memory_order_relaxed), true);
+                    continue;
+                }
+
+                // the move leaves the table, look the position up in the smaller one
+                for (int p = 0; p < (promotion ? 4 : 1); ++p)
+                {
+                    int men = 0;
+                    Piece pieces[MAX_MEN];
+                    Player owners[MAX_MEN];
+                    int childSqrs[MAX_MEN];
+                    for (int c = 0; c < layout.men; ++c)
+                    {
+                        if (c == captured)
+                            continue;
+                        pieces[men] = (c == s && promotion) ? promotionPieces[p] : layout.pieces[c];
+                        owners[men] = layout.owners[c];
+                        childSqrs[men++] = child[c];
+                    }
+                    consider(tbs.lookup(men, pieces, owners, childSqrs, chessboard::opponent(plr)), false);
+                }
+            }
+        }
+
+        if (!anyLegal)
+            return isAttacked(sqrs, all, sqrs[plr], chessboard::opponent(plr)) ? 1 : VAL_DRAW; // checkmate or stalemate
+        int plies = (bestWin >= 0) ? bestWin : (allLost ? worstLoss : -1);
+        if (plies > MAX_DTM)
+        {
+            overflow = true;
+            return VAL_DRAW;
+        }
+        return std::uint8_t(plies + 1); // VAL_DRAW if undecided
+    }
+
+    // stores a value found for a position, a win only replaces an undecided position or a longer win
+    void store(std::atomic<std::uint8_t>& entry, std::uint8_t val)
+    {
+        if (val == VAL_DRAW)
+            return;
+        std::uint8_t cur = entry.load(std::memory_order_relaxed);
+        do
+        {
+            if (cur != VAL_DRAW && cur <= val)
+                return;
+        } while (!entry.compare_exchange_weak(cur, val, std::memory_order_relaxed));
+
+        int plies = val - 1;
+        int prev = maxPlies.load(std::memory_order_relaxed);
+        while (plies > prev && !maxPlies.compare_exchange_weak(prev, plies, std::memory_order_relaxed)) {}
+    }
+
+    // walks the moves leading to a position decided at this distance backwards and updates the positions they start from
+    void propagate(std::size_t i, int level)
+    {
+        int sqrs[MAX_MEN];
+        layout.decode(i % layout.size, sqrs);
+        Player mover = chessboard::opponent(Player(i / layout.size));
+        Bitboard all = occupancy(sqrs, chessboard::WHITE) | occupancy(sqrs, chessboard::BLACK);
+        bool lost = (level & 1) == 0; // lost for the player to move, so won for the mover
+
+        int back = (mover == chessboard::WHITE) ? -8 : 8;
+        int firstRank = (mover == chessboard::WHITE) ? 0 : 7;
+        for (int s = 0; s < layout.men; ++s)
+        {
+            if (layout.owners[s] != mover)
+                continue;
+            Piece piece = layout.pieces[s];
+            int from = sqrs[s];
+
+            // moves are taken back onto empty squares only, captures and promotions lead into other tables
+            Bitboard targets = 0;
+            if (piece == chessboard::PAWN)
+            {
+                int one = from + back;
+                if ((one >> 3) != firstRank && (all & chessboard::sqrBB(one)) == 0)
+                {
+                    targets |= chessboard::sqrBB(one);
+                    if ((from >> 3) == firstRank + 3*(-back/8) && (all & chessboard::sqrBB(one + back)) == 0)
+                        targets |= chessboard::sqrBB(one + back);
+                }
+            }
+            else
+            {
+                targets = pieceAttacks(piece, mover, from, all) & ~all;
+            }
+
+            while (targets)
+            {
+                int prev[MAX_MEN];
+                std::copy(sqrs, sqrs + layout.men, prev);
+                prev[s] = chessboard::popLsb(targets);
+
+                std::atomic<std::uint8_t>& entry = values[mover*layout.size + layout.index(prev)];
+                std::uint8_t cur = entry.load(std::memory_order_relaxed);
+                if (cur == VAL_ILLEGAL)
+                    continue;
+                if (lost)
+                {
+                    if (level + 1 > MAX_DTM)
+                        overflow = true;
+                    else
+                        store(entry, level + 2);
+                }
+                else if (cur == VAL_DRAW)
+                {
+                    store(entry, score(prev, mover, level));
+                }
+            }
+        }
+    }
+};
+
+// [PUBLIC]
+std::unique_ptr<Table> generate(std::string_view sig, const Tablebases& tbs, int numThreads, GenerationStats& stats, std::string& error)
+{
+    Layout layout;
+    if (layout.parse(sig) == false)
+    {
+        error = "invalid signature " + std::string(sig);
+        return nullptr;
+    }
+
+    // every capture and promotion, and both at once, must lead into a table that is already there
+    for (int captured = -1; captured < layout.men; ++captured)
+    {
+        if (captured == 0 || captured == 1)
+            continue; // kings
+        for (int promoted = -1; promoted < layout.men; ++promoted)
+        {
+            if (promoted >= 0 && (promoted == captured || layout.pieces[promoted] != chessboard::PAWN))
+                continue;
+            for (Piece promotion : promotionPieces)
+            {
+                if (captured < 0 && promoted < 0)
+                    break;
+                std::string name = convertedName(layout, captured, promoted, promotion);
+                if (name != "KvK" && tbs.find(name) == nullptr) // the bare kings need no table
+                {
+                    error = layout.name + " needs " + name;
+                    return nullptr;
+                }
+                if (promoted < 0)
+                    break;
+            }
+        }
+    }
+
+    Generator generator(layout, tbs, std::max(numThreads, 1));
+    if (generator.run() == false)
+    {
+        error = layout.name + " has a mate longer than " + std::to_string(MAX_DTM) + " plies";
+        return nullptr;
+    }
+    return std::unique_ptr<Table>(new Table(layout, generator.result(stats)));
+}
+
+} // namespace tablebase
+
+} // namespace gv
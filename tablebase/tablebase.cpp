@@ -0,0 +1,460 @@
+#include "tablebase.h"
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gv
+{
+namespace tablebase
+{
+
+using chessboard::Piece;
+using chessboard::Player;
+
+/**************************************************************************************/
+// MATERIAL
+
+static const char pieceLetters[] = "PRNBQK"; // Piece order
+
+// rank of each piece in the Q R B N P order of signatures, higher comes first, [piece]
+static const int pieceOrder[] = { 0, 3, 1, 2, 4, 5 };
+
+// 4 bit count of each piece type of one side, weighted so more valuable material gives a larger number
+static std::uint64_t sidePart(int men, const Piece* pieces, const Player* owners, Player plr)
+{
+    std::uint64_t part = 0;
+    for (int i = 0; i < men; ++i)
+    {
+        if (owners[i] == plr && pieces[i] != chessboard::KING)
+            part += std::uint64_t(1) << (4*pieceOrder[pieces[i]]);
+    }
+    return part;
+}
+
+// [PUBLIC] white's part in the low 20 bits, black's above
+std::uint64_t materialKey(int men, const Piece* pieces, const Player* owners)
+{
+    return sidePart(men, pieces, owners, chessboard::WHITE) | (sidePart(men, pieces, owners, chessboard::BLACK) << 20);
+}
+
+static std::uint64_t flipKey(std::uint64_t key)
+{
+    return ((key & 0xFFFFF) << 20) | (key >> 20);
+}
+
+static int pieceFromLetter(char c)
+{
+    for (int p = 0; p < 5; ++p)
+    {
+        if (pieceLetters[p] == c)
+            return p;
+    }
+    return -1;
+}
+
+/**************************************************************************************/
+// LAYOUT
+
+// the a1-d1-d4 triangle the white king is mirrored into when there are no pawns
+struct KingTriangle
+{
+    int index[64]; // -1 outside the triangle
+    int square[10];
+
+    constexpr KingTriangle() : index(), square()
+    {
+        int n = 0;
+        for (int sq = 0; sq < 64; ++sq)
+        {
+            int file = sq & 7;
+            int rank = sq >> 3;
+            index[sq] = (file <= 3 && rank <= file) ? n : -1;
+            if (index[sq] >= 0)
+                square[n++] = sq;
+        }
+    }
+};
+
+static constexpr KingTriangle kingTriangle;
+
+// [PUBLIC]
+bool Layout::parse(std::string_view sig)
+{
+    std::size_t v = sig.find('v');
+    if (v == std::string_view::npos)
+        return false;
+    std::string_view sides[2] = { sig.substr(0, v), sig.substr(v + 1) };
+
+    // pieces besides the kings, sorted into signature order
+    std::vector<Piece> sidePieces[2];
+    for (int p = 0; p < 2; ++p)
+    {
+        if (sides[p].empty() || sides[p][0] != 'K')
+            return false;
+        for (char c : sides[p].substr(1))
+        {
+            int piece = pieceFromLetter(c);
+            if (piece < 0)
+                return false;
+            sidePieces[p].push_back((Piece)piece);
+        }
+        std::sort(sidePieces[p].begin(), sidePieces[p].end(), [](Piece a, Piece b) { return pieceOrder[a] > pieceOrder[b]; });
+    }
+
+    men = 2 + sidePieces[0].size() + sidePieces[1].size();
+    if (men < 3 || men > MAX_MEN)
+        return false;
+
+    // the stronger side is white, compared piece by piece from the queens down
+    auto part = [&](int p)
+    {
+        std::uint64_t part = 0;
+        for (Piece piece : sidePieces[p])
+            part += std::uint64_t(1) << (4*pieceOrder[piece]);
+        return part;
+    };
+    if (part(1) > part(0))
+        std::swap(sidePieces[0], sidePieces[1]);
+
+    int slot = 0;
+    pieces[slot] = chessboard::KING;
+    owners[slot++] = chessboard::WHITE;
+    pieces[slot] = chessboard::KING;
+    owners[slot++] = chessboard::BLACK;
+    name.clear();
+    hasPawns = false;
+    for (int p = 0; p < 2; ++p)
+    {
+        name += (p == 0) ? "K" : "vK";
+        for (Piece piece : sidePieces[p])
+        {
+            pieces[slot] = piece;
+            owners[slot++] = (Player)p;
+            name += pieceLetters[piece];
+            hasPawns |= (piece == chessboard::PAWN);
+        }
+    }
+
+    size = hasPawns ? 32 : 10;
+    for (int i = 1; i < men; ++i)
+    {
+        size *= 64;
+    }
+    return true;
+}
+
+// [PUBLIC]
+std::uint64_t Layout::key() const
+{
+    return materialKey(men, pieces, owners);
+}
+
+// [PUBLIC] mirrors the position so the white king lands in its reduced area, then numbers the squares in slot order
+std::size_t Layout::index(const int* sqrs) const
+{
+    int flip = 0; // xor'd into squares, 7 mirrors the files and 56 the ranks
+    if ((sqrs[0] & 7) > 3)
+        flip ^= 7;
+    if (!hasPawns && (sqrs[0] >> 3) > 3)
+        flip ^= 56;
+    int king = sqrs[0] ^ flip;
+    bool swap = !hasPawns && (king >> 3) > (king & 7); // mirrors along the a1-h8 diagonal
+
+    // a king on the diagonal leaves the mirror open, the first man off the diagonal is put below it
+    // so every position has one index and mirrored positions don't get separate entries
+    if (!hasPawns && (king >> 3) == (king & 7))
+    {
+        for (int i = 1; i < men; ++i)
+        {
+            int sq = sqrs[i] ^ flip;
+            if ((sq >> 3) != (sq & 7))
+            {
+                swap = (sq >> 3) > (sq & 7);
+                break;
+            }
+        }
+    }
+
+    auto transform = [&](int sq)
+    {
+        sq ^= flip;
+        return swap ? ((sq & 7) << 3) | (sq >> 3) : sq;
+    };
+
+    std::size_t ind = hasPawns ? (king >> 3)*4 + (king & 7) : kingTriangle.index[transform(sqrs[0])];
+    for (int i = 1; i < men; ++i)
+    {
+        ind = ind*64 + transform(sqrs[i]);
+    }
+    return ind;
+}
+
+// [PUBLIC]
+void Layout::decode(std::size_t ind, int* sqrs) const
+{
+    for (int i = men - 1; i >= 1; --i)
+    {
+        sqrs[i] = ind & 63;
+        ind >>= 6;
+    }
+    sqrs[0] = hasPawns ? int(ind/4)*8 + int(ind%4) : kingTriangle.square[ind];
+}
+
+// [PUBLIC]
+std::vector<std::string> allSignatures(int maxMen)
+{
+    // every multiset of up to maxMen - 2 pieces, as letter strings in signature order
+    std::vector<std::string> sets = { "" };
+    for (std::size_t i = 0; i < sets.size(); ++i)
+    {
+        if ((int)sets[i].size() >= maxMen - 2)
+            continue;
+        static const char order[] = "QRBNP";
+        std::size_t from = sets[i].empty() ? 0 : std::string(order).find(sets[i].back());
+        for (std::size_t p = from; p < 5; ++p)
+        {
+            sets.push_back(sets[i] + order[p]);
+        }
+    }
+
+    std::vector<std::string> names;
+    for (auto& white : sets)
+    {
+        for (auto& black : sets)
+        {
+            Layout layout;
+            int men = 2 + white.size() + black.size();
+            if (men >= 3 && men <= maxMen && layout.parse("K" + white + "vK" + black)
+                && std::find(names.begin(), names.end(), layout.name) == names.end())
+            {
+                names.push_back(layout.name);
+            }
+        }
+    }
+
+    // captures lower the men and promotions the pawns, so sorting by both puts every table after those it converts to
+    auto rank = [](const std::string& name)
+    {
+        return std::make_pair(name.size() - 1, std::count(name.begin(), name.end(), 'P'));
+    };
+    std::stable_sort(names.begin(), names.end(), [&](const std::string& a, const std::string& b) { return rank(a) < rank(b); });
+    return names;
+}
+
+/**************************************************************************************/
+// TABLE
+
+struct FileHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    char name[16];
+    std::uint64_t entries;
+};
+
+static const std::uint32_t FILE_VERSION = 1;
+
+// [PUBLIC]
+Table::Table(const Layout& layout, std::vector<std::uint8_t> vals) : layout(layout), owned(std::move(vals)), mapping(nullptr), mappingSize(0)
+{
+    values = owned.data();
+}
+
+// [PUBLIC]
+Table::~Table()
+{
+    if (mapping)
+        munmap(mapping, mappingSize);
+}
+
+// [PUBLIC]
+std::unique_ptr<Table> Table::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FileHeader))
+    {
+        ::close(fd);
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file open
+    if (addr == MAP_FAILED)
+        return nullptr;
+
+    std::unique_ptr<Table> table(new Table());
+    table->mapping = addr;
+    table->mappingSize = st.st_size;
+
+    FileHeader header;
+    std::memcpy(&header, addr, sizeof(header));
+    header.name[15] = 0;
+    if (std::memcmp(header.magic, "GVTB", 4) != 0 || header.version != FILE_VERSION || table->layout.parse(header.name) == false
+        || table->layout.name != header.name || header.entries != table->layout.size
+        || (std::size_t)st.st_size != sizeof(FileHeader) + 2*header.entries)
+    {
+        return nullptr;
+    }
+    madvise(addr, st.st_size, MADV_RANDOM); // probes touch scattered entries
+    table->values = (const std::uint8_t*)addr + sizeof(FileHeader);
+    return table;
+}
+
+// [PUBLIC]
+bool Table::save(const std::string& path) const
+{
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "GVTB", 4);
+    header.version = FILE_VERSION;
+    std::strncpy(header.name, layout.name.c_str(), sizeof(header.name) - 1);
+    header.entries = layout.size;
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)values, 2*layout.size);
+    return file.good();
+}
+
+// [PUBLIC]
+const Layout& Table::getLayout() const
+{
+    return layout;
+}
+
+// [PUBLIC]
+std::uint8_t Table::value(Player plrToMove, std::size_t ind) const
+{
+    return values[plrToMove*layout.size + ind];
+}
+
+/**************************************************************************************/
+// TABLEBASES
+
+// [PUBLIC]
+int Tablebases::load(const std::string& dir)
+{
+    int loaded = 0;
+    std::error_code ec;
+    for (auto& file : std::filesystem::directory_iterator(dir, ec))
+    {
+        if (file.path().extension() != ".gvtb")
+            continue;
+        std::unique_ptr<Table> table = Table::open(file.path().string());
+        if (table)
+        {
+            add(std::move(table));
+            loaded++;
+        }
+    }
+    return loaded;
+}
+
+// [PUBLIC]
+void Tablebases::add(std::unique_ptr<Table> table)
+{
+    const Layout& layout = table->getLayout();
+    std::uint64_t key = layout.key();
+    byKey[key] = { table.get(), false };
+    if (flipKey(key) != key)
+        byKey[flipKey(key)] = { table.get(), true };
+    maxMen = std::max(maxMen, layout.men);
+    tables.push_back(std::move(table)); // a replaced table stays mapped, lookups already running may still use it
+}
+
+// [PUBLIC]
+const Table* Tablebases::find(std::string_view name) const
+{
+    Layout layout;
+    if (layout.parse(name) == false)
+        return nullptr;
+    auto it = byKey.find(layout.key());
+    return (it != byKey.end() && it->second.flip == false) ? it->second.table : nullptr;
+}
+
+// [PUBLIC]
+int Tablebases::getMaxMen() const
+{
+    return maxMen;
+}
+
+// [PUBLIC]
+std::uint8_t Tablebases::lookup(int men, const Piece* pieces, const Player* owners, const int* sqrs, Player plrToMove) const
+{
+    if (men == 2)
+    {
+        // the two kings
+        return (chessboard::kingAttacks(sqrs[0]) & chessboard::sqrBB(sqrs[1])) ? VAL_ILLEGAL : VAL_DRAW;
+    }
+
+    auto it = byKey.find(materialKey(men, pieces, owners));
+    if (it == byKey.end())
+        return VAL_ILLEGAL;
+    const Layout& layout = it->second.table->getLayout();
+    bool flip = it->second.flip;
+
+    // place each man in the first free slot of its piece and colour, mirroring the ranks if the colours are swapped
+    int slotSqrs[MAX_MEN];
+    bool used[MAX_MEN] = {};
+    for (int s = 0; s < layout.men; ++s)
+    {
+        Player owner = flip ? chessboard::opponent(layout.owners[s]) : layout.owners[s];
+        for (int i = 0; i < men; ++i)
+        {
+            if (!used[i] && pieces[i] == layout.pieces[s] && owners[i] == owner)
+            {
+                used[i] = true;
+                slotSqrs[s] = flip ? sqrs[i] ^ 56 : sqrs[i];
+                break;
+            }
+        }
+    }
+    return it->second.table->value(flip ? chessboard::opponent(plrToMove) : plrToMove, layout.index(slotSqrs));
+}
+
+// [PUBLIC]
+bool Tablebases::probe(const chessboard::Position& pos, ProbeResult& result) const
+{
+    if (pos.castling != 0 || pos.enpssntSqr != 64)
+        return false;
+
+    int men = 0;
+    Piece pieces[MAX_MEN];
+    Player owners[MAX_MEN];
+    int sqrs[MAX_MEN];
+    for (int i = 0; i < 64; ++i)
+    {
+        if (pos.code(i) == 0)
+            continue;
+        if (men == maxMen)
+            return false;
+        pieces[men] = pos.piece(i);
+        owners[men] = pos.owner(i);
+        sqrs[men++] = i;
+    }
+
+    std::uint8_t val = lookup(men, pieces, owners, sqrs, (Player)pos.plrToMove);
+    if (val == VAL_ILLEGAL)
+        return false;
+    int plies = val - 1;
+    result.wdl = (val == VAL_DRAW) ? 0 : ((plies & 1) ? 1 : -1);
+    result.dtm = (val == VAL_DRAW) ? 0 : plies;
+    return true;
+}
+
+// [PUBLIC]
+bool Tablebases::probe(chessboard::Board& board, ProbeResult& result) const
+{
+    if (chessboard::popCount(board.getOccupancyBB(chessboard::WHITE) | board.getOccupancyBB(chessboard::BLACK)) > maxMen)
+        return false;
+    return probe(board.toPosition(), result);
+}
+
+} // namespace tablebase
+
+} // namespace gv
@@ -0,0 +1,135 @@
+/* Endgame tablebases, generated by retrograde analysis and probed by material */
+#pragma once
+
+#include "../chessboard/chessboard.h"
+#include <memory>
+#include <unordered_map>
+
+namespace gv
+{
+
+namespace tablebase
+{
+
+// most pieces, kings included, a table can have
+const int MAX_MEN = 5;
+
+// one byte per position and player to move
+// VAL_DRAW for draws (and positions not yet decided during generation), VAL_ILLEGAL for positions that can't occur,
+// otherwise 1 + the distance to mate in plies, the player to move wins if the distance is odd and loses if it is even
+const std::uint8_t VAL_DRAW = 0;
+const std::uint8_t VAL_ILLEGAL = 255;
+const int MAX_DTM = 253; // longest distance to mate in plies a value can hold
+
+// the pieces of a material signature and how positions with them map to table indices
+// slot 0 holds the white king, slot 1 the black king and the other slots white's then black's pieces in Q R B N P order
+// without pawns the white king is mirrored into the a1-d1-d4 triangle, with pawns only onto files a to d
+struct Layout
+{
+    std::string name; // e.g. "KQvKR", the side with more material is always white
+    int men;
+    chessboard::Piece pieces[MAX_MEN];
+    chessboard::Player owners[MAX_MEN];
+    bool hasPawns;
+    std::size_t size; // entries for each player to move
+
+    bool parse(std::string_view sig); // false if malformed or over MAX_MEN, the sides are swapped if black has more material
+    std::uint64_t key() const; // material key of the pieces as given, see materialKey
+
+    std::size_t index(const int* sqrs) const; // sqrs[slot], any position, the symmetry is applied here
+    void decode(std::size_t ind, int* sqrs) const; // the position of an index, indices that aren't a position's own decode to a mirror of one
+};
+
+// material key of a set of pieces, kings are not counted, a side's pieces count the same in any order
+std::uint64_t materialKey(int men, const chessboard::Piece* pieces, const chessboard::Player* owners);
+
+// canonical names of every signature with 3 up to maxMen men, each after every signature it converts to
+// by a capture or a promotion, so generating them in order always has the smaller tables ready
+std::vector<std::string> allSignatures(int maxMen);
+
+// a table of values indexed [player to move][Layout::index]
+// tables are either generated in memory or memory mapped from a file
+// file format: "GVTB", uint32 version, char name[16] zero padded, uint64 entries per player to move,
+// then the values of white to move followed by those of black to move
+class Table
+{
+
+private:
+    Layout layout;
+    std::vector<std::uint8_t> owned;
+    void* mapping;
+    std::size_t mappingSize;
+    const std::uint8_t* values;
+
+public:
+    Table(const Layout& layout, std::vector<std::uint8_t> values); // values holds 2*layout.size entries
+    Table(const Table&) = delete;
+    Table& operator=(const Table&) = delete;
+    ~Table();
+
+    static std::unique_ptr<Table> open(const std::string& path); // null if the file can't be mapped or is malformed
+    bool save(const std::string& path) const;
+
+    const Layout& getLayout() const;
+    std::uint8_t value(chessboard::Player plrToMove, std::size_t ind) const;
+
+private:
+    Table() : mapping(nullptr), mappingSize(0), values(nullptr) {}
+};
+
+// outcome for the player to move, wdl 1 win, 0 draw, -1 loss, dtm the distance to mate in plies or 0 for a draw
+// tables score positions by best play to mate, the fifty-move rule is not taken into account
+struct ProbeResult
+{
+    int wdl;
+    int dtm;
+};
+
+// a set of tables looked up by material, either colour may hold the stronger side
+class Tablebases
+{
+
+private:
+    struct Entry
+    {
+        const Table* table;
+        bool flip; // the position's colours are swapped relative to the table
+    };
+
+    std::vector<std::unique_ptr<Table>> tables;
+    std::unordered_map<std::uint64_t, Entry> byKey;
+    int maxMen;
+
+public:
+    Tablebases() : maxMen(0) {}
+
+    int load(const std::string& dir); // maps every .gvtb file in a directory, returns how many were loaded
+    void add(std::unique_ptr<Table> table); // replaces any table with the same material
+    const Table* find(std::string_view name) const; // null if there is no table for the signature
+    int getMaxMen() const;
+
+    // false if there is no table for the position, or it has castling rights or an en passant square
+    bool probe(const chessboard::Position& pos, ProbeResult& result) const;
+    bool probe(chessboard::Board& board, ProbeResult& result) const;
+
+    // the value of a position given as men, VAL_ILLEGAL if there is no table for it
+    // positions with only the kings are draws unless the kings touch
+    std::uint8_t lookup(int men, const chessboard::Piece* pieces, const chessboard::Player* owners, const int* sqrs, chessboard::Player plrToMove) const;
+};
+
+// statistics of a generated table, counted over both players to move
+struct GenerationStats
+{
+    long long wins;
+    long long draws;
+    long long losses;
+    int longestMate; // plies
+};
+
+// builds a table by retrograde analysis on numThreads threads, every table the signature converts to must be in tbs
+// returns null and sets error if the signature is malformed, a smaller table is missing or a mate is too long to store
+std::unique_ptr<Table> generate(std::string_view sig, const Tablebases& tbs, int numThreads, GenerationStats& stats, std::string& error);
+
+} // namespace tablebase
+
+} // namespace gv
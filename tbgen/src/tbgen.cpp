@@ -0,0 +1,251 @@
+#include "../../tablebase/tablebase.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+using namespace gv;
+
+/**************************************************************************************************************/
+// VERIFICATION
+
+struct VerifyRun
+{
+    long long checked;
+    long long skipped; // positions with a move that gives an en passant right, which tables don't hold
+    long long wrong;
+};
+
+// checks random positions of a table against its moves generated by Board, each position's value must follow from
+// the values of the positions its legal moves lead to
+static VerifyRun verifyTable(const tablebase::Table& table, const tablebase::Tablebases& tbs, int samples, std::mt19937_64& rng)
+{
+    const tablebase::Layout& layout = table.getLayout();
+    VerifyRun run = { 0, 0, 0 };
+    chessboard::Board board;
+    for (int n = 0; n < samples; ++n)
+    {
+        chessboard::Player plr = chessboard::Player(rng() & 1);
+        std::size_t ind = rng() % layout.size;
+        if (table.value(plr, ind) == tablebase::VAL_ILLEGAL)
+        {
+            n--;
+            continue;
+        }
+
+        int sqrs[tablebase::MAX_MEN];
+        layout.decode(ind, sqrs);
+        chessboard::Position pos;
+        std::memset(&pos, 0, sizeof(pos));
+        for (int s = 0; s < layout.men; ++s)
+        {
+            pos.set(sqrs[s], layout.pieces[s], layout.owners[s]);
+        }
+        pos.plrToMove = plr;
+        pos.enpssntSqr = 64;
+        pos.fullmoveNumber = 1;
+        board.loadPosition(pos);
+
+        tablebase::ProbeResult probed;
+        if (tbs.probe(board, probed) == false)
+        {
+            run.wrong++;
+            continue;
+        }
+
+        // best outcome over the moves, as the table should have it
+        chessboard::MoveList mvs;
+        board.generateMoves(mvs);
+        tablebase::ProbeResult expected = { 0, 0 };
+        if (mvs.size == 0)
+            expected = (board.getCheck() == plr) ? tablebase::ProbeResult{ -1, 0 } : tablebase::ProbeResult{ 0, 0 };
+
+        bool skip = false;
+        bool allLost = (mvs.size > 0);
+        int bestWin = -1;
+        int worstLoss = 0;
+        for (auto mv : mvs)
+        {
+            board.makeMove(mv);
+            tablebase::ProbeResult child;
+            bool found = tbs.probe(board, child);
+            board.unmakeMove();
+            if (!found)
+            {
+                skip = true;
+                break;
+            }
+            if (child.wdl < 0)
+                bestWin = (bestWin < 0) ? child.dtm + 1 : std::min(bestWin, child.dtm + 1);
+            else if (child.wdl == 0)
+                allLost = false;
+            else
+                worstLoss = std::max(worstLoss, child.dtm + 1);
+        }
+        if (skip)
+        {
+            run.skipped++;
+            continue;
+        }
+        if (bestWin >= 0)
+            expected = { 1, bestWin };
+        else if (allLost)
+            expected = { -1, worstLoss };
+
+        run.checked++;
+        if (probed.wdl != expected.wdl || probed.dtm != expected.dtm)
+        {
+            if (run.wrong++ < 5)
+                std::cout << "  " << board.toFEN() << " table " << probed.wdl << " " << probed.dtm << " moves give " << expected.wdl << " " << expected.dtm << std::endl;
+        }
+    }
+    return run;
+}
+
+/**************************************************************************************************************/
+// PROBING
+
+static const char* wdlName(int wdl)
+{
+    return (wdl > 0) ? "win" : ((wdl < 0) ? "loss" : "draw");
+}
+
+// prints the outcome of a position and of each of its moves
+static int probePosition(const tablebase::Tablebases& tbs, const std::string& fen)
+{
+    chessboard::Board board;
+    if (board.loadFEN(fen) == false)
+    {
+        std::cerr << "invalid fen " << fen << std::endl;
+        return 1;
+    }
+
+    tablebase::ProbeResult result;
+    if (tbs.probe(board, result) == false)
+    {
+        std::cout << "not in the tables" << std::endl;
+        return 1;
+    }
+    std::cout << fen << ": " << wdlName(result.wdl) << " dtm " << result.dtm << std::endl;
+
+    chessboard::MoveList mvs;
+    board.generateMoves(mvs);
+    for (auto mv : mvs)
+    {
+        char san[chessboard::SAN_BUFFER_SIZE];
+        board.toSAN(mv, san);
+        board.makeMove(mv);
+        tablebase::ProbeResult child;
+        if (tbs.probe(board, child))
+            std::cout << "  " << san << ": " << wdlName(-child.wdl) << " dtm " << (child.wdl ? child.dtm + 1 : 0) << std::endl;
+        else
+            std::cout << "  " << san << ": not in the tables" << std::endl;
+        board.unmakeMove();
+    }
+    return 0;
+}
+
+/**************************************************************************************************************/
+// MAIN
+
+static void printUsage()
+{
+    std::cout << "usage: tbgen [-men n] [-threads n] [-dir path] [-force] [-verify n] [-probe fen] [signature ...]" << std::endl;
+    std::cout << "generates distance to mate tables for the given signatures (e.g. KQvKR), or every signature of up to n men" << std::endl;
+    std::cout << "(default 4, at most 5), into dir (default .), tables already in dir are kept unless -force is given" << std::endl;
+    std::cout << "-verify checks n random positions of each table against the board's move generator" << std::endl;
+    std::cout << "-probe prints the outcome of a position and of each of its moves from the tables in dir" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int maxMen = 4;
+    int numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+    std::string dir = ".";
+    bool force = false;
+    int verifySamples = 0;
+    std::string probeFEN;
+    std::vector<std::string> signatures;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-men" && i + 1 < argc)
+            maxMen = std::min(std::max(std::atoi(argv[++i]), 3), tablebase::MAX_MEN);
+        else if (arg == "-threads" && i + 1 < argc)
+            numThreads = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "-dir" && i + 1 < argc)
+            dir = argv[++i];
+        else if (arg == "-force")
+            force = true;
+        else if (arg == "-verify" && i + 1 < argc)
+            verifySamples = std::max(std::atoi(argv[++i]), 0);
+        else if (arg == "-probe" && i + 1 < argc)
+            probeFEN = argv[++i];
+        else if (arg[0] != '-')
+            signatures.push_back(arg);
+        else
+        {
+            printUsage();
+            return (arg == "-h" || arg == "-help") ? 0 : 1;
+        }
+    }
+
+    tablebase::Tablebases tbs;
+    tbs.load(dir);
+    if (probeFEN.empty() == false)
+        return probePosition(tbs, probeFEN);
+
+    if (signatures.empty())
+        signatures = tablebase::allSignatures(maxMen);
+
+    std::mt19937_64 rng(1);
+    for (auto& sig : signatures)
+    {
+        tablebase::Layout layout;
+        if (layout.parse(sig) == false)
+        {
+            std::cerr << "invalid signature " << sig << std::endl;
+            return 1;
+        }
+
+        if (force || tbs.find(layout.name) == nullptr)
+        {
+            auto start = std::chrono::steady_clock::now();
+            tablebase::GenerationStats stats;
+            std::string error;
+            std::unique_ptr<tablebase::Table> table = tablebase::generate(layout.name, tbs, numThreads, stats, error);
+            if (!table)
+            {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+            double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::string path = dir + "/" + layout.name + ".gvtb";
+            if (table->save(path) == false)
+            {
+                std::cerr << "could not write " << path << std::endl;
+                return 1;
+            }
+            table = tablebase::Table::open(path); // larger tables are built from the mapped file, which the OS can page out
+            if (!table)
+            {
+                std::cerr << "could not open " << path << std::endl;
+                return 1;
+            }
+            tbs.add(std::move(table));
+            std::cout << layout.name << "  wins " << stats.wins << "  draws " << stats.draws << "  losses " << stats.losses
+                << "  longest mate " << stats.longestMate << " plies  time " << time << " s" << std::endl;
+        }
+
+        if (verifySamples > 0)
+        {
+            VerifyRun run = verifyTable(*tbs.find(layout.name), tbs, verifySamples, rng);
+            std::cout << layout.name << "  verified " << run.checked << "  skipped " << run.skipped << "  wrong " << run.wrong << std::endl;
+            if (run.wrong > 0)
+                return 1;
+        }
+    }
+    return 0;
+}
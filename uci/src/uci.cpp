@@ -0,0 +1,394 @@
+#include "../../search/smp.h"
+#include "../../book/book.h"
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace gv;
+
+/**************************************************************************************************************/
+// ENGINE
+
+static std::string moveToUCI(chessboard::PackedMove mv)
+{
+    char str[chessboard::UCI_BUFFER_SIZE];
+    chessboard::Board::toUCI(mv, str);
+    return str;
+}
+
+static const std::string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// reads UCI commands from stdin, searches run on their own thread so stop and isready are answered while searching
+class Engine
+{
+
+private:
+    chessboard::Board board;
+    search::TranspositionTable tt;
+    search::ParallelSearch searcher;
+    std::thread searchThread;
+    std::atomic<bool> stopRequested; // set by stop, lets an infinite search report its move
+    bool infinite;
+    std::mutex outputMutex;
+    book::Book openingBook;
+    std::mt19937_64 bookRng;
+
+public:
+    Engine() : tt(16), searcher(&tt, 1), stopRequested(false), infinite(false), bookRng(std::random_device()())
+    {
+        board.loadFEN(START_FEN);
+        searcher.setInfoCallback([this](const search::SearchResult& result) { sendInfo(result); });
+    }
+
+    ~Engine()
+    {
+        stopSearch();
+    }
+
+    // returns false on quit
+    bool command(const std::string& line)
+    {
+        std::istringstream is(line);
+        std::string token;
+        is >> token;
+
+        if (token == "uci")
+        {
+            send("id name gv");
+            send("id author gv");
+            send("option name Hash type spin default 16 min 1 max 65536");
+            send("option name Threads type spin default 1 min 1 max 256");
+            send("option name EvalFile type string default <empty>");
+            send("option name BookFile type string default <empty>");
+            send("option name BookKeysFile type string default <empty>");
+            send("uciok");
+        }
+        else if (token == "isready")
+        {
+            send("readyok");
+        }
+        else if (token == "ucinewgame")
+        {
+            stopSearch();
+            tt.clear();
+        }
+        else if (token == "position")
+        {
+            stopSearch();
+            position(is);
+        }
+        else if (token == "go")
+        {
+            stopSearch();
+            go(is);
+        }
+        else if (token == "stop")
+        {
+            stopSearch();
+        }
+        else if (token == "setoption")
+        {
+            stopSearch();
+            setOption(is);
+        }
+        else if (token == "bench")
+        {
+            stopSearch();
+            bench(is);
+        }
+        else if (token == "d")
+        {
+            send(board.toFEN());
+        }
+        else if (token == "quit")
+        {
+            return false;
+        }
+        else if (token.empty() == false)
+        {
+            send("info string unknown command " + token);
+        }
+        return true;
+    }
+
+private:
+    void send(const std::string& str)
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cout << str << std::endl;
+    }
+
+    static std::string scoreToUCI(int score)
+    {
+        if (std::abs(score) >= search::SCORE_MATE - search::MAX_PLY)
+        {
+            int plies = search::SCORE_MATE - std::abs(score);
+            int moves = (plies + 1) / 2;
+            return "mate " + std::to_string(score > 0 ? moves : -moves);
+        }
+        return "cp " + std::to_string(score);
+    }
+
+    void sendInfo(const search::SearchResult& result)
+    {
+        std::ostringstream os;
+        os << "info depth " << result.depth << " score " << scoreToUCI(result.score) << " nodes " << result.nodes
+            << " nps " << (long long)(result.nodes / std::max(result.time, 1e-3)) << " time " << (long long)(result.time*1000)
+            << " hashfull " << tt.getHashfull() << " pv";
+        for (auto mv : result.pv)
+        {
+            os << " " << moveToUCI(mv);
+        }
+        send(os.str());
+    }
+
+    // position [startpos | fen <fen>] [moves <move> ...]
+    void position(std::istringstream& is)
+    {
+        std::string token, fen;
+        is >> token;
+        if (token == "startpos")
+        {
+            fen = START_FEN;
+            is >> token;
+        }
+        else if (token == "fen")
+        {
+            while (is >> token && token != "moves")
+            {
+                fen += token + " ";
+            }
+        }
+        else
+        {
+            send("info string expected startpos or fen");
+            return;
+        }
+
+        if (board.loadFEN(fen) == false)
+        {
+            send("info string invalid fen " + fen);
+            board.loadFEN(START_FEN);
+            return;
+        }
+
+        if (token == "moves")
+        {
+            while (is >> token)
+            {
+                chessboard::PackedMove mv = board.fromUCI(token);
+                if (mv.isNull())
+                {
+                    send("info string illegal move " + token);
+                    return;
+                }
+                board.makeMove(mv);
+            }
+        }
+    }
+
+    // go [depth d] [nodes n] [movetime ms] [wtime ms] [btime ms] [winc ms] [binc ms] [movestogo n] [infinite]
+    void go(std::istringstream& is)
+    {
+        search::SearchLimits limits;
+        int time[2] = { 0, 0 };
+        int inc[2] = { 0, 0 };
+        int movesToGo = 0;
+        infinite = false;
+
+        std::string token;
+        while (is >> token)
+        {
+            if (token == "depth")
+                is >> limits.depth;
+            else if (token == "nodes")
+                is >> limits.nodes;
+            else if (token == "movetime")
+                is >> limits.movetime;
+            else if (token == "wtime")
+                is >> time[chessboard::WHITE];
+            else if (token == "btime")
+                is >> time[chessboard::BLACK];
+            else if (token == "winc")
+                is >> inc[chessboard::WHITE];
+            else if (token == "binc")
+                is >> inc[chessboard::BLACK];
+            else if (token == "movestogo")
+                is >> movesToGo;
+            else if (token == "infinite")
+                infinite = true;
+        }
+
+        // with a clock, spend an even share of the remaining time plus most of the increment, keeping a margin
+        chessboard::Player plr = board.getPlayerToMove();
+        if (limits.movetime == 0 && time[plr] > 0)
+        {
+            int share = time[plr] / ((movesToGo > 0) ? movesToGo + 1 : 30) + inc[plr]*3/4;
+            limits.movetime = std::max(std::min(share, time[plr] - 50), 1);
+        }
+
+        // book moves are played without searching, except when analysing
+        if (openingBook.isOpen() && !infinite)
+        {
+            chessboard::PackedMove mv = openingBook.pickMove(board, bookRng());
+            if (!mv.isNull())
+            {
+                send("bestmove " + moveToUCI(mv));
+                return;
+            }
+        }
+
+        // cleared here rather than by the search thread, so a stop that arrives before it starts still stops it
+        stopRequested = false;
+        searcher.clearStop();
+        searchThread = std::thread([this, limits]()
+        {
+            chessboard::Board searchBoard = board;
+            search::SearchResult result = searcher.search(searchBoard, limits);
+
+            // an infinite search only reports its move once told to stop
+            while (infinite && !stopRequested)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            send("bestmove " + moveToUCI(result.bestMove));
+        });
+    }
+
+    void stopSearch()
+    {
+        if (searchThread.joinable())
+        {
+            stopRequested = true;
+            searcher.stop();
+            searchThread.join();
+        }
+    }
+
+    // setoption name <id> [value <x>]
+    void setOption(std::istringstream& is)
+    {
+        std::string token, name, value;
+        is >> token;
+        while (is >> token && token != "value")
+        {
+            name += (name.empty() ? "" : " ") + token;
+        }
+        while (is >> token)
+        {
+            value += (value.empty() ? "" : " ") + token;
+        }
+
+        if (name == "Hash")
+        {
+            tt.resize(std::max(std::atoi(value.c_str()), 1));
+        }
+        else if (name == "Threads")
+        {
+            searcher.setThreads(std::max(std::atoi(value.c_str()), 1));
+        }
+        else if (name == "EvalFile")
+        {
+            search::Evaluator eval;
+            if (value.empty() == false && value != "<empty>")
+            {
+                std::shared_ptr<search::Network> network(new search::Network());
+                if (network->load(value) == false)
+                {
+                    send("info string could not load network " + value);
+                    return;
+                }
+                eval.setNetwork(network);
+            }
+            searcher.setEvaluator(eval);
+        }
+        else if (name == "BookFile")
+        {
+            openingBook.close();
+            if (value.empty() == false && value != "<empty>" && openingBook.open(value) == false)
+            {
+                send("info string could not open book " + value);
+            }
+            else if (openingBook.isOpen() && openingBook.getKeys().isStandard() == false)
+            {
+                send("info string book keys are not the standard Polyglot table, only books written with them will match");
+            }
+        }
+        else if (name == "BookKeysFile")
+        {
+            // another table of Polyglot random numbers, for books written with their own, empty goes back to the standard one
+            openingBook.getKeys() = book::PolyglotKeys();
+            if (value.empty() == false && value != "<empty>" && openingBook.getKeys().load(value) == false)
+            {
+                send("info string could not read 781 keys from " + value);
+            }
+            else if (openingBook.getKeys().isStandard() == false)
+            {
+                send("info string book keys are not the standard Polyglot table, only books written with them will match");
+            }
+        }
+        else
+        {
+            send("info string unknown option " + name);
+        }
+    }
+
+    // bench [depth], searches the bench positions to a fixed depth and reports the total nodes and speed
+    void bench(std::istringstream& is)
+    {
+        int depth = 8;
+        is >> depth;
+
+        search::SearchLimits limits;
+        limits.depth = std::max(depth, 1);
+
+        long long nodes = 0;
+        double time = 0.0;
+        searcher.clearStop();
+        searcher.setInfoCallback(nullptr);
+        for (auto& fen : search::benchPositions)
+        {
+            chessboard::Board benchBoard;
+            benchBoard.loadFEN(fen);
+            tt.clear();
+            search::SearchResult result = searcher.search(benchBoard, limits);
+            nodes += result.nodes;
+            time += result.time;
+            send("info string " + fen + " bestmove " + moveToUCI(result.bestMove) + " nodes " + std::to_string(result.nodes));
+        }
+        searcher.setInfoCallback([this](const search::SearchResult& result) { sendInfo(result); });
+        tt.clear();
+
+        send("info string bench nodes " + std::to_string(nodes) + " time " + std::to_string((long long)(time*1000))
+            + " nps " + std::to_string((long long)(nodes / std::max(time, 1e-3))));
+    }
+};
+
+/**************************************************************************************************************/
+// MAIN
+
+// commands given on the command line are run before reading stdin, e.g. "uci bench 6" runs the bench and exits
+int main(int argc, char** argv)
+{
+    Engine engine;
+    if (argc > 1)
+    {
+        std::string line;
+        for (int i = 1; i < argc; ++i)
+        {
+            line += std::string(argv[i]) + " ";
+        }
+        engine.command(line);
+        return 0;
+    }
+
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        if (engine.command(line) == false)
+            break;
+    }
+    return 0;
+}